@@ -9,20 +9,57 @@
 // Zone types
 # define TINY_ZONE      0
 # define SMALL_ZONE     1
-# define LARGE_ZONE     2
+# define MEDIUM_ZONE    2
+# define LARGE_ZONE     3
 
-// Size limits
-# define TINY_MAX       512
-# define SMALL_MAX      4096
+# define ZONE_TYPES     4
+
+// Zone flags
+# define ZONE_DRAINING  0x1     // Skipped by malloc_compact()
+# define ZONE_REGION    0x2     // Owned by a region, ignored by free()
+# define ZONE_PERSISTENT 0x4    // Lives in a persistent heap file
+
+// Build flavors, selected with -DFT_FLAVOR_<NAME> (see `make flavors`):
+//   LATENCY - larger quick lists, deferred coalescing on, prefaulted zones
+//   COMPACT - narrower tiers and smaller zones, free pages go back to the
+//             kernel as soon as they appear
+//   DEBUG   - poisoned blocks, diagnostics for invalid and double frees
+# ifdef FT_FLAVOR_COMPACT
+#  define TINY_MAX          256
+#  define SMALL_MAX         2048
+#  define TINY_ZONE_PAGES   8
+#  define SMALL_ZONE_PAGES  64
+#  define MEDIUM_ZONE_PAGES 1024
+#  define PURGE_ON_FREE     1   // MADV_DONTNEED free pages on every free
+# else
+#  define TINY_MAX          512
+#  define SMALL_MAX         4096
+#  define TINY_ZONE_PAGES   16
+#  define SMALL_ZONE_PAGES  128
+#  define MEDIUM_ZONE_PAGES 4096
+#  define PURGE_ON_FREE     0
+# endif
 
 // Zone sizes (must contain at least 100 allocations)
-# define TINY_ZONE_SIZE     (getpagesize() * 16)    
-# define SMALL_ZONE_SIZE    (getpagesize() * 128)   
+# define TINY_ZONE_SIZE     (getpagesize() * TINY_ZONE_PAGES)
+# define SMALL_ZONE_SIZE    (getpagesize() * SMALL_ZONE_PAGES)
+
+// MEDIUM tier: page runs carved out of shared zones, up to MEDIUM_MAX.
+// Free runs are binned by length in pages; runs of MEDIUM_BINS - 1 pages
+// or more share the last bin.
+# define MEDIUM_MAX         (1024 * 1024)
+# define MEDIUM_ZONE_SIZE   (getpagesize() * MEDIUM_ZONE_PAGES)
+# define MEDIUM_BINS        257
+# define RUN_FREE           0x1
+# define RUN_NONE           UINT32_MAX
 
 // Alignment
 # define ALIGNMENT      16
 # define ALIGN(size)    (((size) + (ALIGNMENT - 1)) & ~(ALIGNMENT - 1))
 
+// Zones used below this percentage are worth draining
+# define DRAIN_THRESHOLD    50
+
 // Headers
 # define ZONE_HEADER_SIZE   sizeof(t_zone)
 # define BLOCK_HEADER_SIZE  sizeof(t_block)
@@ -34,6 +71,50 @@
 # define SET_FREE(s)    ((s) | BLOCK_FREE)
 # define CLEAR_FREE(s)  ((s) & ~BLOCK_FREE)
 
+// Freed block parked on a quick list: not free for coalescing purposes
+# define BLOCK_QUICK    0x2
+# define IS_QUICK(s)    ((s) & BLOCK_QUICK)
+
+// Deferred coalescing (enabled with FT_MALLOC_DEFERRED=1)
+# define QUICK_BINS     (SMALL_MAX / ALIGNMENT)
+# ifdef FT_FLAVOR_LATENCY
+#  define QUICK_BIN_MAX     128
+#  define QUICK_MAX         4096
+#  define DEFERRED_DEFAULT  1   // FT_MALLOC_DEFERRED=0 still turns it off
+#  define PREFAULT_ZONES    1   // MAP_POPULATE new TINY/SMALL zones
+# else
+#  define QUICK_BIN_MAX     32  // Blocks per size before a sweep
+#  define QUICK_MAX         512 // Blocks overall before a sweep
+#  define DEFERRED_DEFAULT  0
+#  define PREFAULT_ZONES    0
+# endif
+
+// Fill patterns of the debug flavor
+# define DEBUG_ALLOC_BYTE   0xAA
+# define DEBUG_FREE_BYTE    0xDD
+
+// Free pages are only purged when at least this many can be dropped
+# define PURGE_MIN_PAGES    1
+
+// Page map entry. Only the first and last page of a run carry its length;
+// free runs are linked through their first entry.
+typedef struct s_run {
+    uint32_t    pages;      // Run length in pages, 0 for inner pages
+    uint32_t    flags;      // RUN_FREE
+    uint32_t    next;       // Free list links, as page indices
+    uint32_t    prev;
+} t_run;
+
+// Follows the zone header of MEDIUM zones. Every run starts with a regular
+// block header, so block walks work on MEDIUM zones as well.
+typedef struct s_medium {
+    uint32_t    pages;                  // Data pages in the zone
+    uint32_t    first;                  // Page offset of the first data page
+    uint32_t    bins[MEDIUM_BINS];      // First free run per length
+    uint64_t    bitmap[(MEDIUM_BINS + 63) / 64];
+    t_run       map[];                  // One entry per data page
+} t_medium;
+
 typedef struct s_block {
     size_t      size;       // Size with flags in lower bits
     size_t      prev_size;  // Size of previous block
@@ -44,40 +125,403 @@ typedef struct s_zone {
     struct s_zone   *prev;
     size_t          size;
     int             type;
+    int             flags;      // ZONE_* flags
     size_t          free_blocks;
     size_t          free_size;
 } t_zone;
 
+typedef struct s_zone_usage {
+    void            *zone;          // Zone base address
+    size_t          zone_size;
+    size_t          used_size;      // Bytes in live blocks
+    size_t          free_size;      // Usable bytes not in live blocks
+    size_t          free_blocks;
+    size_t          largest_free;   // Largest single free block
+    size_t          deferred_blocks; // Freed blocks waiting on quick lists
+    int             type;
+    int             occupancy;      // Percentage of usable bytes in use
+    int             draining;       // Zone is marked ZONE_DRAINING
+    int             should_move;    // Moving objects out helps release it
+} t_zone_usage;
+
+// Bump-allocation region: blocks are carved off the free tail of the
+// newest zone and released all at once by region_reset/region_destroy
+typedef struct s_region {
+    struct s_region *next;
+    struct s_region *prev;
+    t_zone          *zones;     // Zones owned by the region, by address
+    t_zone          *current;   // Zone being bump-allocated
+    t_block         *tail;      // Free remainder of the current zone
+    t_block         *last;      // Most recent allocation
+} t_region;
+
+// Reserved address space (enabled with FT_MALLOC_RESERVE=<size>).
+// Zones are carved from one PROT_NONE mapping in granules; owner[] maps
+// each granule to its zone so pointer ownership is an O(1) lookup.
+typedef struct s_reserve {
+    char            *base;      // NULL when the mode is off
+    size_t          size;
+    size_t          granule;    // TINY_ZONE_SIZE
+    size_t          count;      // Number of granules
+    size_t          committed;  // Bytes made accessible, always a prefix
+    size_t          hint;       // Every granule below is in use
+    uint32_t        *owner;     // First granule of the owning zone + 1
+} t_reserve;
+
+// Quick lists: freed TINY/SMALL blocks by exact size, linked through their
+// payload (next block, then owning zone)
+typedef struct s_quick_lists {
+    t_block         *bins[QUICK_BINS];
+    uint32_t        counts[QUICK_BINS];
+    size_t          total;
+    size_t          hits;
+    size_t          misses;     // Lookups that found the bin empty
+    size_t          sweeps;
+} t_quick_lists;
+
+// Allocator-wide counters
+typedef struct s_malloc_stats {
+    size_t          mapped;             // Bytes in live zones
+    size_t          peak_mapped;
+    size_t          zones[ZONE_TYPES];  // Live zones per tier
+    size_t          peak_zones[ZONE_TYPES];
+    size_t          reclaims;
+    size_t          purged;             // Bytes returned with MADV_DONTNEED
+    size_t          syscalls;           // mmap/munmap/mprotect/madvise on zones
+    size_t          destroyed;          // Zones released, for malloc_iterate
+} t_malloc_stats;
+
+// Called when the hard limit is hit; return non-zero to retry
+typedef int (*t_budget_callback)(size_t requested, size_t mapped);
+
+// Heap budget (FT_MALLOC_SOFT_LIMIT / FT_MALLOC_HARD_LIMIT, defaulting to
+// the cgroup memory limit). Crossing the soft limit triggers reclamation,
+// the hard limit makes zone creation fail.
+typedef struct s_budget {
+    size_t              soft_limit;
+    size_t              hard_limit;
+    size_t              next_reclaim;   // Mapped bytes for the next reclaim
+    t_budget_callback   callback;
+    int                 reclaiming;
+} t_budget;
+
+// Adaptive SMALL/MEDIUM boundary (FT_MALLOC_ADAPTIVE=1). Requests between
+// SMALL_MAX and CLASS_LIMIT are sampled by 16-byte class; every CLASS_EPOCH
+// samples the boundary moves to where the estimated cost (page rounding in
+// MEDIUM, header and stranded space in SMALL) is lowest. Zones keep their
+// blocks, only new requests are routed differently. The report measures
+// internal fragmentation only (header, alignment and page rounding).
+# define CLASS_LIMIT        16384
+# define CLASS_BINS         ((CLASS_LIMIT - SMALL_MAX) / ALIGNMENT)
+# define CLASS_SAMPLE_EVERY 4       // In-range requests per sample
+# define CLASS_EPOCH        128     // Samples between re-derivations
+# define CLASS_SMALL_SLACK  4       // SMALL blocks strand 1/4 of their size
+
+typedef struct s_size_classes {
+    size_t          small_max;      // Learned boundary, 0 for SMALL_MAX
+    int             adaptive;
+    uint32_t        tick;
+    uint32_t        samples;        // Since the last re-derivation
+    uint32_t        counts[CLASS_BINS];     // Halved at each re-derivation
+    size_t          derivations;
+    size_t          sampled;        // Totals over every sample so far
+    size_t          requested;
+    size_t          frag_fixed;     // Internal fragmentation with SMALL_MAX
+    size_t          frag_learned;   // Internal fragmentation as placed
+} t_size_classes;
+
+typedef struct s_class_report {
+    size_t          small_max;      // SMALL/MEDIUM boundary in use
+    size_t          derivations;
+    size_t          sampled;
+    size_t          requested;
+    size_t          frag_fixed;
+    size_t          frag_learned;
+} t_class_report;
+
 typedef struct s_malloc_data {
     t_zone          *tiny_zones;
     t_zone          *small_zones;
+    t_zone          *medium_zones;
     t_zone          *large_zones;
+    t_region        *regions;
+    int             tracing;    // Set when FT_MALLOC_TRACE is active
+    int             latency;    // Set when latency histograms are on
+    int             deferred;   // Set when frees go to the quick lists
+    t_quick_lists   quick;
+    t_reserve       reserve;
+    t_malloc_stats  stats;
+    t_budget        budget;
+    t_size_classes  classes;
+    struct s_shm_stats *shm;    // Published stats page, NULL when off
 } t_malloc_data;
 
+// Allocation tracing (enabled with FT_MALLOC_TRACE=<file>)
+# define TRACE_MAGIC        "FTMTRACE"
+# define TRACE_VERSION      2
+# define TRACE_RING_EVENTS  4096
+# define TRACE_FLUSH_NS     10000000
+
+# define TRACE_MALLOC   1
+# define TRACE_FREE     2
+# define TRACE_REALLOC  3
+
+// Latency histograms (enabled with FT_MALLOC_LATENCY=1)
+# define LAT_MALLOC         0
+# define LAT_FREE           1
+# define LAT_REALLOC        2
+# define LAT_OPS            3
+
+# define LAT_PATH_HIT       0   // Served from an existing zone
+# define LAT_PATH_NEW_ZONE  1   // Had to create a TINY/SMALL zone
+# define LAT_PATH_SYSCALL   2   // Mapped or released a dedicated mapping
+# define LAT_PATHS          3
+
+// Log-linear buckets: 4 sub-buckets per power of two of TSC ticks
+# define LAT_SUB_BITS       2
+# define LAT_BUCKETS        256
+
+// Heap profile for startup warm-up (FT_MALLOC_PROFILE=<file>)
+# define PROFILE_MAGIC      "FTMPROF"
+# define PROFILE_VERSION    2
+# define PROFILE_MAX_ZONES  1024    // Per tier, caps a corrupt/huge profile
+
+typedef struct s_heap_profile {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    page_size;                  // Zone sizes depend on it
+    uint64_t    zones[ZONE_TYPES];          // Peak zone count per tier
+    uint64_t    classes[QUICK_BINS];        // Live blocks per 16-byte class
+} t_heap_profile;
+
+// Shared-memory stats page (FT_MALLOC_SHM=1), /dev/shm/ft_malloc.<pid>.
+// Every field is written with relaxed atomic stores; readers only need
+// `seq` to tell that the page is still being refreshed.
+# define SHM_STATS_MAGIC    "FTMSTAT"
+# define SHM_STATS_VERSION  2
+# define SHM_STATS_PREFIX   "/ft_malloc."
+# define SHM_STATS_EVERY    256     // Public calls between tier refreshes
+
+typedef struct s_shm_tier {
+    uint64_t    mapped;         // Bytes in zones, headers included
+    uint64_t    used;           // Payload of live (and parked) blocks
+    uint64_t    free;
+    uint64_t    zones;
+    uint64_t    free_blocks;
+} t_shm_tier;
+
+typedef struct s_shm_stats {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    pid;
+    uint64_t    seq;                // Bumped after every refresh
+    uint64_t    calls[LAT_OPS];     // malloc / free / realloc
+    uint64_t    syscalls;
+    uint64_t    quick_hits;
+    uint64_t    quick_misses;
+    uint64_t    reclaims;
+    uint64_t    peak_mapped;
+    t_shm_tier  tiers[ZONE_TYPES];
+} t_shm_stats;
+
+// Heap iteration: malloc_iterate() reports each zone, then its blocks
+# define HEAP_ZONE          0
+# define HEAP_LIVE          1
+# define HEAP_FREE          2       // Free, or parked on a quick list
+# define HEAP_VISIT_ZONES   (1 << HEAP_ZONE)
+# define HEAP_VISIT_LIVE    (1 << HEAP_LIVE)
+# define HEAP_VISIT_FREE    (1 << HEAP_FREE)
+# define HEAP_VISIT_ALL     (HEAP_VISIT_ZONES | HEAP_VISIT_LIVE | HEAP_VISIT_FREE)
+
+typedef struct s_heap_entry {
+    void        *zone;
+    size_t      zone_size;
+    int         type;       // Zone tier
+    int         flags;      // ZONE_* flags
+    int         kind;       // HEAP_ZONE / HEAP_LIVE / HEAP_FREE
+    void        *ptr;       // Block payload, or the zone itself
+    size_t      size;
+} t_heap_entry;
+
+// Return non-zero to stop the iteration
+typedef int (*t_heap_visitor)(const t_heap_entry *entry, void *arg);
+
+// Epoch-based reclamation: free_deferred() retires a block, which is freed
+// once every reader inside malloc_epoch_enter/exit has moved two epochs on.
+// Readers may run on any thread; free_deferred and malloc_epoch_reclaim free
+// blocks and, like malloc/free, must not run concurrently with other calls.
+# define EPOCH_BATCH        64      // Retirements between reclaim attempts
+
+// Persistent heap: zones in a file mapped MAP_SHARED at a fixed address, so
+// pointers stored in it stay valid when another process reopens it. The
+// header page is followed by zones laid out back to back.
+# define PHEAP_MAGIC        "FTMHEAP"
+# define PHEAP_VERSION      1
+# define PHEAP_BASE         0x200000000000UL    // Default fixed address
+# define PHEAP_SPAN         (64UL << 30)        // Default address space
+# define PHEAP_ZONE_PAGES   256
+
+typedef struct s_pheap_header {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    page_size;
+    uint32_t    zone_header;    // sizeof(t_zone), sizeof(t_block) below
+    uint32_t    block_header;
+    uint64_t    base;           // Address the file must be mapped at
+    uint64_t    span;           // Address space reserved for growth
+    uint64_t    size;           // Bytes in use: header page + zones
+    uint64_t    root;           // Entry point for the application
+    uint32_t    dirty;          // Set while a process has the heap open
+    uint32_t    checksum;       // FNV-1a of the fields above
+} t_pheap_header;
+
+typedef struct s_pheap {
+    t_pheap_header  *header;    // At header->base
+    int             fd;
+} t_pheap;
+
+typedef struct s_latency_snapshot {
+    uint64_t    ticks_per_us;
+    uint64_t    counts[LAT_OPS][ZONE_TYPES][LAT_PATHS][LAT_BUCKETS];
+} t_latency_snapshot;
+
+typedef struct s_trace_header {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    event_size;
+    uint64_t    dropped;    // Events lost to write errors, set at exit
+} t_trace_header;
+
+typedef struct s_trace_event {
+    uint64_t    timestamp;  // CLOCK_MONOTONIC, nanoseconds
+    uint64_t    ptr;        // Returned pointer (its address is the object ID)
+    uint64_t    arg;        // Pointer passed in (free/realloc)
+    uint64_t    size;       // Requested size
+    uint32_t    tid;        // Kernel thread ID
+    uint32_t    op;         // TRACE_MALLOC / TRACE_FREE / TRACE_REALLOC
+} t_trace_event;
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
 // Global allocator data
 extern t_malloc_data g_malloc_data;
+extern __thread int  g_latency_path;
+extern __thread int  g_latency_tier;
 
 // Public functions
 void    free(void *ptr);
 void    *malloc(size_t size);
 void    *realloc(void *ptr, size_t size);
+void    *aligned_alloc(size_t alignment, size_t size);
+int     posix_memalign(void **memptr, size_t alignment, size_t size);
+void    free_sized(void *ptr, size_t size);
+void    free_aligned_sized(void *ptr, size_t alignment, size_t size);
 void    show_alloc_mem(void);
+int     malloc_zone_usage(void *ptr, t_zone_usage *usage);
+size_t  malloc_zone_usage_batch(void **ptrs, size_t count,
+                                t_zone_usage *usages);
+int     malloc_drain_zone(void *ptr, int enable);
+void    *malloc_compact(size_t size);
+void    *malloc_near(void *hint, size_t size);
+size_t  malloc_iterate(int what, t_heap_visitor visitor, void *arg);
+void    malloc_adaptive_enable(int enable);
+void    malloc_class_report(t_class_report *report);
+int     malloc_reserve(size_t size);
+void    malloc_latency_enable(int enable);
+void    malloc_latency_snapshot(t_latency_snapshot *snapshot);
+void    malloc_latency_reset(void);
+uint64_t malloc_latency_percentile(const uint64_t *buckets, double percentile);
+void    show_alloc_latency(void);
+void    malloc_deferred_enable(int enable);
+void    malloc_flush_deferred(void);
+void    malloc_set_budget(size_t soft_limit, size_t hard_limit);
+void    malloc_set_budget_callback(t_budget_callback callback);
+size_t  malloc_reclaim(void);
+int     malloc_profile_save(const char *path);
+int     malloc_profile_load(const char *path, t_heap_profile *profile);
+size_t  malloc_warm(const t_heap_profile *profile, int prefault);
+int     malloc_stats_publish(int enable);
+t_region *region_create(void);
+void    *region_alloc(t_region *region, size_t size);
+int     region_free_last(t_region *region, void *ptr);
+void    region_reset(t_region *region);
+void    region_destroy(t_region *region);
+void    free_deferred(void *ptr);
+void    malloc_epoch_enter(void);
+void    malloc_epoch_exit(void);
+size_t  malloc_epoch_reclaim(void);
+t_pheap *pheap_open(const char *path, void *base, size_t span);
+void    *pheap_alloc(t_pheap *heap, size_t size);
+void    pheap_free(t_pheap *heap, void *ptr);
+void    *pheap_root(t_pheap *heap);
+void    pheap_set_root(t_pheap *heap, void *ptr);
+int     pheap_check(t_pheap *heap);
+int     pheap_sync(t_pheap *heap);
+int     pheap_close(t_pheap *heap);
 
 // Internal functions
+void    *internal_malloc(size_t size);
+void    *allocate_in_list(t_zone **list, int type, size_t size,
+                          int skip_flags);
+int     get_zone_type(size_t size);
+t_zone  **get_zone_list(int type);
+size_t  get_zone_size(int type, size_t size);
+void    internal_free(void *ptr);
+void    free_in_zone(t_zone *zone, void *ptr);
+void    release_block(t_zone *zone, t_block *block);
+int     quick_push(t_zone *zone, t_block *block);
+void    *quick_pop(size_t size);
+void    *internal_aligned_alloc(size_t alignment, size_t size);
+void    *internal_realloc(void *ptr, size_t size);
+void    trace_record(uint32_t op, void *ptr, void *arg, size_t size);
+uint64_t latency_begin(void);
+void    latency_end(int op, int tier, uint64_t start);
+void    latency_path(int path);
+void    shm_stats_tick(int op);
+void    shm_stats_refresh(void);
+void    class_sample(size_t requested);
 t_zone  *create_zone(size_t size, int type);
+void    adopt_zone(t_zone *zone, size_t size, int type);
+void    init_zone(t_zone *zone, size_t size, int type);
+t_block *zone_first_block(t_zone *zone);
+size_t  zone_capacity(t_zone *zone);
+void    medium_init_zone(t_zone *zone);
+void    *medium_alloc(t_zone *zone, size_t size);
+void    medium_free(t_zone *zone, t_block *block);
+void    destroy_zone(t_zone *zone);
+int     budget_admit(size_t size);
+int     zone_is_reserved(void *ptr);
+t_zone  *reserve_zone(size_t size);
+void    reserve_release(t_zone *zone);
+t_zone  *reserve_find_zone(void *ptr);
 void    *allocate_in_zone(t_zone *zone, size_t size);
+void    *allocate_block(t_zone *zone, t_block *block, size_t size,
+                        int from_end);
 t_block *find_free_block(t_zone *zone, size_t size);
 void    split_block(t_block *block, size_t size, char *zone_end);
-void    coalesce_blocks(t_zone *zone, t_block *block);
+t_block *coalesce_blocks(t_zone *zone, t_block *block);
+size_t  purge_block(t_block *block);
+void    debug_report(const char *what, void *ptr);
+void    debug_fill(void *ptr, size_t size, int byte);
+void    shrink_block(t_zone *zone, t_block *block, size_t size);
 int     zone_is_empty(t_zone *zone);
 void    remove_zone(t_zone **list, t_zone *zone);
 void    add_zone(t_zone **list, t_zone *zone);
+t_zone  *find_zone_in_list(t_zone *list, void *ptr);
 t_zone  *find_zone_for_ptr(void *ptr);
 void    *ft_memcpy(void *dst, const void *src, size_t n);
+int     ft_memcmp(const void *s1, const void *s2, size_t n);
 void    ft_bzero(void *s, size_t n);
+size_t  ft_parse_size(const char *s);
 void    ft_putstr(const char *s);
 void    ft_putnbr(size_t n);
 void    ft_putchar(char c);
 void    print_hex(size_t n);
 
+# ifdef __cplusplus
+}
+# endif
+
 #endif
\ No newline at end of file
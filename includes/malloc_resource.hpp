@@ -0,0 +1,65 @@
+#ifndef MALLOC_RESOURCE_HPP
+# define MALLOC_RESOURCE_HPP
+
+# include <cstddef>
+# include <memory_resource>
+# include <new>
+# include "malloc.h"
+
+namespace ft {
+
+// Allocate with an explicit alignment, following operator new semantics
+// (new_handler loop, std::bad_alloc on failure)
+void    *allocate(std::size_t size, std::size_t alignment);
+void    deallocate(void *ptr, std::size_t size, std::size_t alignment) noexcept;
+
+// std::pmr adapter: sizes and alignments are forwarded to the allocator
+class malloc_resource : public std::pmr::memory_resource {
+protected:
+    void    *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void    do_deallocate(void *ptr, std::size_t bytes,
+                          std::size_t alignment) override;
+    bool    do_is_equal(const std::pmr::memory_resource &other)
+                const noexcept override;
+};
+
+// Process-wide instance, like std::pmr::new_delete_resource()
+std::pmr::memory_resource   *malloc_memory_resource() noexcept;
+
+// Standard allocator for containers that bypasses operator new entirely
+template <class T>
+struct malloc_allocator {
+    typedef T   value_type;
+
+    malloc_allocator() noexcept = default;
+    template <class U>
+    malloc_allocator(const malloc_allocator<U> &) noexcept {}
+
+    T *allocate(std::size_t n)
+    {
+        if (n > static_cast<std::size_t>(-1) / sizeof(T))
+            throw std::bad_array_new_length();
+        return static_cast<T *>(ft::allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *ptr, std::size_t n) noexcept
+    {
+        ft::deallocate(ptr, n * sizeof(T), alignof(T));
+    }
+};
+
+template <class T, class U>
+bool operator==(const malloc_allocator<T> &, const malloc_allocator<U> &) noexcept
+{
+    return true;
+}
+
+template <class T, class U>
+bool operator!=(const malloc_allocator<T> &, const malloc_allocator<U> &) noexcept
+{
+    return false;
+}
+
+}
+
+#endif
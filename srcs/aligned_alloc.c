@@ -0,0 +1,118 @@
+#include "malloc.h"
+#include <errno.h>
+
+// Turn the front of an allocated block into a free block so that the
+// remaining part starts at an aligned address. The padding in the request
+// guarantees the leading free block gets at least ALIGNMENT bytes.
+static t_block *align_block(t_zone *zone, t_block *block, size_t alignment)
+{
+    t_block *aligned;
+    t_block *next;
+    char *user;
+    char *target;
+    size_t lead;
+    size_t rest;
+    
+    user = (char *)block + BLOCK_HEADER_SIZE;
+    if (((uintptr_t)user & (alignment - 1)) == 0)
+        return block;
+    
+    target = (char *)(((uintptr_t)user + BLOCK_HEADER_SIZE + ALIGNMENT
+                       + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    lead = target - user - BLOCK_HEADER_SIZE;
+    rest = GET_SIZE(block->size) - lead - BLOCK_HEADER_SIZE;
+    
+    aligned = (t_block *)(target - BLOCK_HEADER_SIZE);
+    aligned->size = rest;
+    aligned->prev_size = lead;
+    next = (t_block *)(target + rest);
+    if ((char *)next < (char *)zone + zone->size)
+        next->prev_size = rest;
+    
+    block->size = SET_FREE(lead);
+    zone->free_blocks++;
+    zone->free_size += lead + BLOCK_HEADER_SIZE;
+    coalesce_blocks(zone, block);
+    
+    return aligned;
+}
+
+void *internal_aligned_alloc(size_t alignment, size_t size)
+{
+    t_zone *zone;
+    t_block *block;
+    void *ptr;
+    size_t padded;
+    
+    if (alignment == 0 || (alignment & (alignment - 1)))
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (size == 0)
+        return NULL;
+    if (alignment <= ALIGNMENT)
+        return internal_malloc(size);
+    
+    size = ALIGN(size);
+    padded = size + alignment + BLOCK_HEADER_SIZE + ALIGNMENT;
+    if (padded < size)
+        return NULL;
+    
+    // MEDIUM runs start one header past a page boundary and cannot be
+    // trimmed from the front, so those requests get their own mapping
+    if (get_zone_type(padded) == MEDIUM_ZONE)
+        ptr = allocate_in_list(get_zone_list(LARGE_ZONE), LARGE_ZONE, padded, 0);
+    else
+        ptr = internal_malloc(padded);
+    if (!ptr)
+        return NULL;
+    
+    zone = find_zone_for_ptr(ptr);
+    block = align_block(zone, (t_block *)((char *)ptr - BLOCK_HEADER_SIZE),
+                        alignment);
+    
+    // LARGE zones are unmapped as a whole, so only trim shared zones
+    if (zone->type <= SMALL_ZONE)
+        shrink_block(zone, block, size);
+    
+    return (char *)block + BLOCK_HEADER_SIZE;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    void *ptr;
+    uint64_t start;
+    
+    start = g_malloc_data.latency ? latency_begin() : 0;
+    ptr = internal_aligned_alloc(alignment, size);
+    if (start)
+        latency_end(LAT_MALLOC, get_zone_type(ALIGN(size) + alignment), start);
+    if (g_malloc_data.tracing)
+        trace_record(TRACE_MALLOC, ptr, NULL, size);
+    if (g_malloc_data.shm)
+        shm_stats_tick(LAT_MALLOC);
+    return ptr;
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *ptr;
+    
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)))
+        return EINVAL;
+    
+    ptr = aligned_alloc(alignment, size);
+    if (!ptr && size)
+        return ENOMEM;
+    *memptr = ptr;
+    return 0;
+}
+
+void free_aligned_sized(void *ptr, size_t alignment, size_t size)
+{
+    // Aligned blocks were carved out of a padded request
+    if (alignment > ALIGNMENT)
+        size = ALIGN(size) + alignment + BLOCK_HEADER_SIZE + ALIGNMENT;
+    free_sized(ptr, size);
+}
@@ -5,7 +5,9 @@ void *allocate_in_zone(t_zone *zone, size_t size)
     t_block *block;
     char *zone_end;
     size_t block_size;
-    size_t actual_size;
+    
+    if (zone->type == MEDIUM_ZONE)
+        return medium_alloc(zone, size);
     
     zone_end = (char *)zone + zone->size;
     block = (t_block *)((char *)zone + ZONE_HEADER_SIZE);
@@ -19,27 +21,7 @@ void *allocate_in_zone(t_zone *zone, size_t size)
             break;
             
         if (IS_FREE(block->size) && block_size >= size)
-        {
-            // Check if we should split
-            if (block_size > size + BLOCK_HEADER_SIZE + ALIGNMENT)
-            {
-                actual_size = ALIGN(size); 
-                split_block(block, actual_size, zone_end);  // Pass aligned size
-            }
-            else
-            {
-                // No split, use entire block
-                actual_size = block_size;
-                // We decrement num of free blocks
-                zone->free_blocks--;
-            }
-            
-            // Clear the FREE bit to mark as allocated
-            block->size = actual_size;
-            
-            zone->free_size -= actual_size;
-            return (char *)block + BLOCK_HEADER_SIZE;
-        }
+            return allocate_block(zone, block, size, 0);
         
         // Move to next block
         block = (t_block *)((char *)block + BLOCK_HEADER_SIZE + block_size);
@@ -48,6 +30,40 @@ void *allocate_in_zone(t_zone *zone, size_t size)
     return NULL;
 }
 
+// Carve `size` bytes out of a free block, from its front or from its end.
+// The whole block is used when the rest would be too small to split off.
+void *allocate_block(t_zone *zone, t_block *block, size_t size, int from_end)
+{
+    char *zone_end;
+    size_t block_size;
+    
+    zone_end = (char *)zone + zone->size;
+    block_size = GET_SIZE(block->size);
+    size = ALIGN(size);
+    
+    if (block_size <= size + BLOCK_HEADER_SIZE + ALIGNMENT)
+    {
+        size = block_size;
+        zone->free_blocks--;
+    }
+    else if (from_end && size > ALIGNMENT)
+    {
+        // Split off the front, then hand it back as the free part (like
+        // any split, the tail must be larger than ALIGNMENT)
+        split_block(block, block_size - size - BLOCK_HEADER_SIZE, zone_end);
+        block->size = SET_FREE(block->size);
+        block = (t_block *)((char *)block + BLOCK_HEADER_SIZE
+                            + GET_SIZE(block->size));
+    }
+    else
+        split_block(block, size, zone_end);
+    
+    // Clear the FREE bit to mark as allocated
+    block->size = size;
+    zone->free_size -= size;
+    return (char *)block + BLOCK_HEADER_SIZE;
+}
+
 void split_block(t_block *block, size_t size, char *zone_end)
 {
     t_block *new_block;
@@ -79,7 +95,7 @@ void split_block(t_block *block, size_t size, char *zone_end)
     }
 }
 
-void coalesce_blocks(t_zone *zone, t_block *block)
+t_block *coalesce_blocks(t_zone *zone, t_block *block)
 {
     t_block *next;
     t_block *prev;
@@ -126,4 +142,41 @@ void coalesce_blocks(t_zone *zone, t_block *block)
                 next->prev_size = total_size;
             }
         }
-}
\ No newline at end of file
+    return block;
+}
+
+void shrink_block(t_zone *zone, t_block *block, size_t size)
+{
+    t_block *tail;
+    size_t old_size;
+    
+    old_size = GET_SIZE(block->size);
+    if (old_size <= size + BLOCK_HEADER_SIZE + ALIGNMENT)
+        return;
+    
+    // Give the tail back to the zone as a free block
+    split_block(block, size, (char *)zone + zone->size);
+    tail = (t_block *)((char *)block + BLOCK_HEADER_SIZE + size);
+    zone->free_blocks++;
+    zone->free_size += old_size - size;
+    coalesce_blocks(zone, tail);
+}
+
+// Give the whole pages inside a free block back to the kernel. Block
+// headers sit outside those pages, so the zone layout is untouched.
+size_t purge_block(t_block *block)
+{
+    size_t page;
+    uintptr_t start;
+    uintptr_t end;
+
+    page = (size_t)getpagesize();
+    start = ((uintptr_t)block + BLOCK_HEADER_SIZE + page - 1) & ~(page - 1);
+    end = ((uintptr_t)block + BLOCK_HEADER_SIZE + GET_SIZE(block->size))
+          & ~(page - 1);
+    if (end < start + PURGE_MIN_PAGES * page
+        || madvise((void *)start, end - start, MADV_DONTNEED) != 0)
+        return 0;
+    g_malloc_data.stats.syscalls++;
+    return end - start;
+}
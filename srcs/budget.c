@@ -0,0 +1,286 @@
+#include "malloc.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+
+// Drop every empty zone of a tier, including the one free() keeps around
+static void release_empty_zones(t_zone **list)
+{
+    t_zone *zone;
+    t_zone *next;
+
+    zone = *list;
+    while (zone)
+    {
+        next = zone->next;
+        if (zone_is_empty(zone))
+        {
+            remove_zone(list, zone);
+            destroy_zone(zone);
+        }
+        zone = next;
+    }
+}
+
+// Give the whole pages inside free blocks back to the kernel
+static size_t purge_free_pages(t_zone *zone)
+{
+    t_block *block;
+    char *zone_end;
+    size_t block_size;
+    size_t purged = 0;
+
+    while (zone)
+    {
+        zone_end = (char *)zone + zone->size;
+        block = zone_first_block(zone);
+        while ((char *)block < zone_end)
+        {
+            block_size = GET_SIZE(block->size);
+            if (block_size == 0 || (char *)block + BLOCK_HEADER_SIZE + block_size > zone_end)
+                break;
+            if (IS_FREE(block->size))
+                purged += purge_block(block);
+            block = (t_block *)((char *)block + BLOCK_HEADER_SIZE + block_size);
+        }
+        zone = zone->next;
+    }
+
+    return purged;
+}
+
+size_t malloc_reclaim(void)
+{
+    t_budget *budget = &g_malloc_data.budget;
+    size_t mapped;
+    size_t purged;
+
+    if (budget->reclaiming)
+        return 0;
+    budget->reclaiming = 1;
+
+    mapped = g_malloc_data.stats.mapped;
+    malloc_flush_deferred();
+    release_empty_zones(&g_malloc_data.tiny_zones);
+    release_empty_zones(&g_malloc_data.small_zones);
+    release_empty_zones(&g_malloc_data.medium_zones);
+    purged = purge_free_pages(g_malloc_data.tiny_zones)
+             + purge_free_pages(g_malloc_data.small_zones)
+             + purge_free_pages(g_malloc_data.medium_zones);
+
+    g_malloc_data.stats.reclaims++;
+    g_malloc_data.stats.purged += purged;
+    budget->reclaiming = 0;
+    return mapped - g_malloc_data.stats.mapped + purged;
+}
+
+// Decide whether a new zone of `size` bytes may be mapped
+int budget_admit(size_t size)
+{
+    t_budget *budget = &g_malloc_data.budget;
+    t_malloc_stats *stats = &g_malloc_data.stats;
+
+    if (budget->reclaiming)
+        return 1;
+
+    // Soft limit: reclaim on the way up, then again every 1/8th of the
+    // limit so a heap that stays above it does not reclaim on every zone
+    if (budget->soft_limit && stats->mapped + size > budget->soft_limit)
+    {
+        if (stats->mapped + size >= budget->next_reclaim)
+        {
+            malloc_reclaim();
+            budget->next_reclaim = stats->mapped + size
+                                   + budget->soft_limit / 8;
+        }
+    }
+    else
+        budget->next_reclaim = 0;
+
+    if (!budget->hard_limit || stats->mapped + size <= budget->hard_limit)
+        return 1;
+
+    // Hard limit: reclaim, then let the application free memory
+    malloc_reclaim();
+    while (stats->mapped + size > budget->hard_limit)
+    {
+        if (!budget->callback || !budget->callback(size, stats->mapped))
+        {
+            errno = ENOMEM;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void malloc_set_budget(size_t soft_limit, size_t hard_limit)
+{
+    g_malloc_data.budget.soft_limit = soft_limit;
+    g_malloc_data.budget.hard_limit = hard_limit;
+    g_malloc_data.budget.next_reclaim = 0;
+}
+
+void malloc_set_budget_callback(t_budget_callback callback)
+{
+    g_malloc_data.budget.callback = callback;
+}
+
+// Size in a cgroup limit file, 0 when missing or unlimited
+static size_t read_limit_file(const char *path)
+{
+    char buf[32];
+    ssize_t len;
+    size_t limit;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return 0;
+    buf[len] = '\0';
+    if (buf[len - 1] == '\n')
+        buf[len - 1] = '\0';
+    limit = ft_parse_size(buf);
+    // "max" (v2) or a page-rounded LONG_MAX (v1) mean unlimited
+    return limit < ((size_t)1 << 60) ? limit : 0;
+}
+
+// Whether a comma-separated controller list contains `name` (an empty
+// name matches the empty list of the v2 hierarchy)
+static int has_controller(const char *list, const char *list_end,
+                          const char *name, size_t len)
+{
+    const char *item_end;
+
+    if (len == 0)
+        return list == list_end;
+    while (list < list_end)
+    {
+        for (item_end = list; item_end < list_end && *item_end != ','; item_end++)
+            ;
+        if ((size_t)(item_end - list) == len && ft_memcmp(list, name, len) == 0)
+            return 1;
+        list = item_end + 1;
+    }
+    return 0;
+}
+
+// Path of this process's cgroup from /proc/self/cgroup, whose lines read
+// "<id>:<controllers>:<path>": the v2 line has no controllers, a v1 line
+// lists `controller`. Returns the path length, or -1 if there is none.
+static int own_cgroup(const char *controller, char *path, size_t size)
+{
+    static char buf[4096];
+    const char *line;
+    const char *end;
+    const char *list;
+    const char *list_end;
+    size_t len;
+    ssize_t nread;
+    int fd;
+
+    fd = open("/proc/self/cgroup", O_RDONLY);
+    if (fd < 0)
+        return -1;
+    nread = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (nread <= 0)
+        return -1;
+    buf[nread] = '\0';
+
+    len = 0;
+    while (controller[len])
+        len++;
+    for (line = buf; *line; line = *end ? end + 1 : end)
+    {
+        for (end = line; *end && *end != '\n'; end++)
+            ;
+        for (list = line; list < end && *list != ':'; list++)
+            ;
+        if (list++ == end)
+            continue;
+        for (list_end = list; list_end < end && *list_end != ':'; list_end++)
+            ;
+        if (list_end == end || !has_controller(list, list_end, controller, len)
+            || (size_t)(end - list_end - 1) >= size)
+            continue;
+        ft_memcpy(path, list_end + 1, end - list_end - 1);
+        path[end - list_end - 1] = '\0';
+        return (int)(end - list_end - 1);
+    }
+    return -1;
+}
+
+// Lowest limit from this process's cgroup up to the root of a hierarchy:
+// a service in a nested cgroup (systemd, systemd-run --scope) is bound by
+// its own memory.max and by every ancestor's, while the root usually says
+// "max". Without /proc/self/cgroup only the root is read.
+static size_t hierarchy_limit(const char *mount, const char *controller,
+                              const char *file)
+{
+    char path[512];
+    size_t mount_len;
+    size_t file_len;
+    size_t limit = 0;
+    size_t found;
+    int len;
+
+    mount_len = 0;
+    while (mount[mount_len])
+        mount_len++;
+    file_len = 0;
+    while (file[file_len])
+        file_len++;
+    ft_memcpy(path, mount, mount_len);
+    len = own_cgroup(controller, path + mount_len,
+                     sizeof(path) - mount_len - file_len - 2);
+    if (len < 0)
+        len = 0;
+    while (1)
+    {
+        // Drop a trailing '/' so the root reads "<mount>/<file>"
+        if (len > 0 && path[mount_len + len - 1] == '/')
+            len--;
+        path[mount_len + len] = '/';
+        ft_memcpy(path + mount_len + len + 1, file, file_len + 1);
+        found = read_limit_file(path);
+        if (found && (!limit || found < limit))
+            limit = found;
+        if (len == 0)
+            return limit;
+        while (len > 0 && path[mount_len + len - 1] != '/')
+            len--;
+    }
+}
+
+// cgroup v2 memory.max, then cgroup v1 memory.limit_in_bytes.
+// Returns 0 when there is no limit.
+static size_t read_cgroup_limit(void)
+{
+    size_t limit;
+
+    limit = hierarchy_limit("/sys/fs/cgroup", "", "memory.max");
+    if (!limit)
+        limit = hierarchy_limit("/sys/fs/cgroup/memory", "memory",
+                                "memory.limit_in_bytes");
+    return limit;
+}
+
+// Priority 101: must be set up before the profile warm-up maps zones
+__attribute__((constructor(101)))
+static void budget_init(void)
+{
+    size_t soft;
+    size_t hard;
+
+    soft = ft_parse_size(getenv("FT_MALLOC_SOFT_LIMIT"));
+    hard = ft_parse_size(getenv("FT_MALLOC_HARD_LIMIT"));
+    if (!hard)
+        hard = read_cgroup_limit();
+    if (!soft && hard)
+        soft = hard / 8 * 7;
+    malloc_set_budget(soft, hard);
+}
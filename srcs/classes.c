@@ -0,0 +1,121 @@
+#include "malloc.h"
+#include <stdlib.h>
+
+// Cost of placing an aligned size in each tier, used to choose the
+// boundary. A MEDIUM run is rounded up to whole pages; a SMALL block costs
+// its header, plus an estimate of what large first-fit blocks strand in
+// holes. That estimate is a heuristic and is never reported.
+static size_t small_cost(size_t size)
+{
+    return BLOCK_HEADER_SIZE + size / CLASS_SMALL_SLACK;
+}
+
+static size_t run_size(size_t size)
+{
+    size_t page = getpagesize();
+
+    return (size + BLOCK_HEADER_SIZE + page - 1) / page * page;
+}
+
+static size_t medium_cost(size_t size)
+{
+    return run_size(size) - size;
+}
+
+static size_t class_size(size_t bin)
+{
+    return SMALL_MAX + (bin + 1) * ALIGNMENT;
+}
+
+// Pick the boundary with the least cost over the decayed samples. Ties go
+// to the lower boundary, so SMALL only grows to cover sizes actually seen.
+static void class_derive(t_size_classes *classes)
+{
+    uint64_t cost = 0;
+    uint64_t best;
+    size_t boundary = 0;
+    size_t bin;
+
+    for (bin = 0; bin < CLASS_BINS; bin++)
+        cost += (uint64_t)classes->counts[bin] * medium_cost(class_size(bin));
+    best = cost;
+    for (bin = 0; bin < CLASS_BINS; bin++)
+    {
+        if (classes->counts[bin] == 0)
+            continue;
+        cost = cost + (uint64_t)classes->counts[bin]
+                        * small_cost(class_size(bin))
+                - (uint64_t)classes->counts[bin]
+                  * medium_cost(class_size(bin));
+        if (cost < best)
+        {
+            best = cost;
+            boundary = class_size(bin);
+        }
+    }
+
+    // Older samples count half as much after every epoch
+    for (bin = 0; bin < CLASS_BINS; bin++)
+        classes->counts[bin] >>= 1;
+    classes->small_max = boundary;
+    classes->samples = 0;
+    classes->derivations++;
+}
+
+void class_sample(size_t requested)
+{
+    t_size_classes *classes = &g_malloc_data.classes;
+    size_t size = ALIGN(requested);
+    size_t in_run;
+    size_t in_small;
+
+    if (++classes->tick < CLASS_SAMPLE_EVERY)
+        return;
+    classes->tick = 0;
+
+    // Internal fragmentation under both boundaries, before it can move:
+    // header and alignment in SMALL, page rounding (which covers both) in
+    // MEDIUM
+    in_run = run_size(size) - requested;
+    in_small = size - requested + BLOCK_HEADER_SIZE;
+    classes->sampled++;
+    classes->requested += requested;
+    classes->frag_fixed += in_run;
+    classes->frag_learned += size <= classes->small_max ? in_small : in_run;
+
+    classes->counts[(size - SMALL_MAX) / ALIGNMENT - 1]++;
+    if (++classes->samples >= CLASS_EPOCH)
+        class_derive(classes);
+}
+
+// Enabling starts from a clean slate, disabling restores SMALL_MAX. Blocks
+// already placed stay where they are either way.
+void malloc_adaptive_enable(int enable)
+{
+    t_size_classes *classes = &g_malloc_data.classes;
+
+    ft_bzero(classes, sizeof(t_size_classes));
+    classes->adaptive = enable != 0;
+}
+
+void malloc_class_report(t_class_report *report)
+{
+    t_size_classes *classes = &g_malloc_data.classes;
+
+    report->small_max = classes->small_max ? classes->small_max : SMALL_MAX;
+    report->derivations = classes->derivations;
+    report->sampled = classes->sampled;
+    report->requested = classes->requested;
+    report->frag_fixed = classes->frag_fixed;
+    report->frag_learned = classes->frag_learned;
+}
+
+__attribute__((constructor))
+static void classes_init(void)
+{
+    const char *value;
+
+    value = getenv("FT_MALLOC_ADAPTIVE");
+    if (value && *value && *value != '0')
+        malloc_adaptive_enable(1);
+}
@@ -0,0 +1,39 @@
+#include "malloc.h"
+
+// Helpers of the debug flavor (-DFT_FLAVOR_DEBUG); unused otherwise
+
+void debug_fill(void *ptr, size_t size, int byte)
+{
+    unsigned char *p = ptr;
+
+    while (size--)
+        *p++ = (unsigned char)byte;
+}
+
+// "ft_malloc: free(): <what> 0x<ptr>" on stderr, without stdio
+void debug_report(const char *what, void *ptr)
+{
+    static const char prefix[] = "ft_malloc: free(): ";
+    static const char hex[] = "0123456789abcdef";
+    char buf[3 + sizeof(uintptr_t) * 2 + 1];
+    uintptr_t value = (uintptr_t)ptr;
+    size_t len;
+    int i;
+
+    len = 0;
+    while (what[len])
+        len++;
+    buf[0] = ' ';
+    buf[1] = '0';
+    buf[2] = 'x';
+    for (i = (int)sizeof(uintptr_t) * 2 - 1; i >= 0; i--)
+    {
+        buf[3 + i] = hex[value & 0xf];
+        value >>= 4;
+    }
+    buf[sizeof(buf) - 1] = '\n';
+    if (write(2, prefix, sizeof(prefix) - 1) < 0
+        || write(2, what, len) < 0
+        || write(2, buf, sizeof(buf)) < 0)
+        return;
+}
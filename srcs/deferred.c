@@ -0,0 +1,101 @@
+#include "malloc.h"
+#include <stdlib.h>
+
+// Quick list links live in the (unused) payload of the parked block
+#define QUICK_NEXT(b)   (((t_block **)((char *)(b) + BLOCK_HEADER_SIZE))[0])
+#define QUICK_ZONE(b)   (((t_zone **)((char *)(b) + BLOCK_HEADER_SIZE))[1])
+
+int quick_push(t_zone *zone, t_block *block)
+{
+    t_quick_lists *quick = &g_malloc_data.quick;
+    size_t size;
+    size_t bin;
+
+    size = GET_SIZE(block->size);
+    if (zone->type == LARGE_ZONE || size > SMALL_MAX)
+        return 0;
+
+    bin = size / ALIGNMENT - 1;
+    if (quick->counts[bin] >= QUICK_BIN_MAX || quick->total >= QUICK_MAX)
+        malloc_flush_deferred();
+
+    block->size = size | BLOCK_QUICK;
+    QUICK_NEXT(block) = quick->bins[bin];
+    QUICK_ZONE(block) = zone;
+    quick->bins[bin] = block;
+    quick->counts[bin]++;
+    quick->total++;
+    return 1;
+}
+
+void *quick_pop(size_t size)
+{
+    t_quick_lists *quick = &g_malloc_data.quick;
+    t_block *block;
+    size_t bin;
+
+    if (size > SMALL_MAX)
+        return NULL;
+
+    bin = size / ALIGNMENT - 1;
+    block = quick->bins[bin];
+    if (!block)
+    {
+        quick->misses++;
+        return NULL;
+    }
+
+    quick->bins[bin] = QUICK_NEXT(block);
+    quick->counts[bin]--;
+    quick->total--;
+    quick->hits++;
+    block->size = GET_SIZE(block->size);
+    return (char *)block + BLOCK_HEADER_SIZE;
+}
+
+// Batch sweep: release every parked block, coalescing it with its
+// neighbours and unmapping zones that become empty
+void malloc_flush_deferred(void)
+{
+    t_quick_lists *quick = &g_malloc_data.quick;
+    t_block *block;
+    t_block *next;
+    size_t bin;
+
+    if (quick->total == 0)
+        return;
+
+    for (bin = 0; bin < QUICK_BINS; bin++)
+    {
+        block = quick->bins[bin];
+        while (block)
+        {
+            next = QUICK_NEXT(block);
+            release_block(QUICK_ZONE(block), block);
+            block = next;
+        }
+        quick->bins[bin] = NULL;
+        quick->counts[bin] = 0;
+    }
+    quick->total = 0;
+    quick->sweeps++;
+}
+
+void malloc_deferred_enable(int enable)
+{
+    if (!enable)
+        malloc_flush_deferred();
+    g_malloc_data.deferred = enable != 0;
+}
+
+__attribute__((constructor))
+static void deferred_init(void)
+{
+    const char *value;
+
+    value = getenv("FT_MALLOC_DEFERRED");
+    if (value && *value)
+        malloc_deferred_enable(*value != '0');
+    else
+        malloc_deferred_enable(DEFERRED_DEFAULT);
+}
@@ -0,0 +1,239 @@
+#include "malloc.h"
+#include <pthread.h>
+
+// Epoch-based reclamation. A reader publishes the global epoch it entered
+// in; the epoch only moves on once every active reader has seen it, so a
+// block retired in epoch e can no longer be reached when the global epoch
+// is e + 2. Thread records are kept in a registry that is never unlinked,
+// like the latency blocks: an exited thread's record, and the blocks it
+// still had retired, go to the next thread that needs one. Only enter/exit
+// are safe to call concurrently: the release pass goes through
+// free_in_zone, so writers are serialized like every other allocator call.
+typedef struct s_retired {
+    void        *ptr;
+    uint64_t    epoch;
+} t_retired;
+
+typedef struct s_epoch_thread {
+    struct s_epoch_thread   *next;      // Registry link, never unlinked
+    int                     in_use;
+    uint64_t                state;      // (epoch << 1) | 1 inside a section
+    unsigned                nesting;
+    unsigned                pending;    // Retired since the last reclaim
+    t_retired               *retired;   // Oldest first
+    size_t                  count;
+    size_t                  capacity;
+} t_epoch_thread;
+
+static t_epoch_thread       *g_epoch_threads = NULL;
+static uint64_t             g_epoch = 0;
+static pthread_key_t        g_epoch_key;
+static int                  g_epoch_key_ready = 0;
+
+static __thread t_epoch_thread *t_epoch = NULL;
+
+static void epoch_release_thread(void *arg)
+{
+    t_epoch_thread *thread = arg;
+
+    thread->nesting = 0;
+    __atomic_store_n(&thread->state, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&thread->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static t_epoch_thread *epoch_thread(void)
+{
+    t_epoch_thread *thread;
+    int expected;
+
+    if (t_epoch)
+        return t_epoch;
+
+    thread = __atomic_load_n(&g_epoch_threads, __ATOMIC_ACQUIRE);
+    while (thread)
+    {
+        expected = 0;
+        if (__atomic_compare_exchange_n(&thread->in_use, &expected, 1, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            break;
+        thread = thread->next;
+    }
+
+    if (!thread)
+    {
+        thread = mmap(NULL, sizeof(t_epoch_thread), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (thread == MAP_FAILED)
+            return NULL;
+        thread->in_use = 1;
+        thread->next = __atomic_load_n(&g_epoch_threads, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&g_epoch_threads, &thread->next,
+                                            thread, 0, __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED))
+            ;
+    }
+
+    if (g_epoch_key_ready)
+        pthread_setspecific(g_epoch_key, thread);
+    t_epoch = thread;
+    return thread;
+}
+
+// Move the global epoch on if every active reader is in the current one
+static void epoch_try_advance(void)
+{
+    t_epoch_thread *thread;
+    uint64_t epoch;
+    uint64_t state;
+
+    epoch = __atomic_load_n(&g_epoch, __ATOMIC_SEQ_CST);
+    thread = __atomic_load_n(&g_epoch_threads, __ATOMIC_ACQUIRE);
+    while (thread)
+    {
+        state = __atomic_load_n(&thread->state, __ATOMIC_SEQ_CST);
+        if ((state & 1) && (state >> 1) != epoch)
+            return;
+        thread = thread->next;
+    }
+    __atomic_compare_exchange_n(&g_epoch, &epoch, epoch + 1, 0,
+                                __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+// Free every block retired two epochs ago through free_in_zone, which parks
+// it on a quick list in deferred mode. Blocks retired together usually
+// share a zone, so the zone lookup is cached across the batch.
+static size_t epoch_release(t_epoch_thread *thread)
+{
+    t_zone *zone = NULL;
+    char *start = NULL;
+    char *end = NULL;
+    char *ptr;
+    uint64_t epoch;
+    size_t mapped;
+    size_t n;
+    size_t i;
+
+    epoch = __atomic_load_n(&g_epoch, __ATOMIC_ACQUIRE);
+    if (epoch < 2)
+        return 0;
+
+    n = 0;
+    while (n < thread->count && thread->retired[n].epoch <= epoch - 2)
+    {
+        ptr = thread->retired[n++].ptr;
+        if (!zone || ptr < start || ptr >= end)
+        {
+            zone = find_zone_for_ptr(ptr);
+            if (!zone)
+                continue;
+            start = (char *)zone;
+            end = start + zone->size;
+        }
+        if (g_malloc_data.tracing)
+            trace_record(TRACE_FREE, NULL, ptr, 0);
+        mapped = g_malloc_data.stats.mapped;
+        free_in_zone(zone, ptr);
+        // The zone may just have been unmapped
+        if (g_malloc_data.stats.mapped != mapped)
+            zone = NULL;
+    }
+
+    for (i = n; i < thread->count; i++)
+        thread->retired[i - n] = thread->retired[i];
+    thread->count -= n;
+    return n;
+}
+
+static int epoch_grow(t_epoch_thread *thread)
+{
+    t_retired *retired;
+    size_t capacity;
+
+    capacity = thread->capacity ? thread->capacity * 2
+                                : getpagesize() / sizeof(t_retired);
+    retired = mmap(NULL, capacity * sizeof(t_retired), PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (retired == MAP_FAILED)
+        return -1;
+    if (thread->retired)
+    {
+        ft_memcpy(retired, thread->retired, thread->count * sizeof(t_retired));
+        munmap(thread->retired, thread->capacity * sizeof(t_retired));
+    }
+    thread->retired = retired;
+    thread->capacity = capacity;
+    return 0;
+}
+
+void malloc_epoch_enter(void)
+{
+    t_epoch_thread *thread;
+    uint64_t epoch;
+
+    thread = epoch_thread();
+    if (!thread || thread->nesting++ > 0)
+        return;
+    epoch = __atomic_load_n(&g_epoch, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&thread->state, (epoch << 1) | 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void malloc_epoch_exit(void)
+{
+    t_epoch_thread *thread = t_epoch;
+
+    if (!thread || thread->nesting == 0 || --thread->nesting > 0)
+        return;
+    __atomic_store_n(&thread->state, 0, __ATOMIC_RELEASE);
+}
+
+void free_deferred(void *ptr)
+{
+    t_epoch_thread *thread;
+
+    if (!ptr)
+        return;
+    // Without a record the block cannot be tracked; leaking it is the
+    // only choice that stays safe for readers
+    thread = epoch_thread();
+    if (!thread)
+        return;
+
+    if (thread->count == thread->capacity)
+    {
+        epoch_try_advance();
+        epoch_release(thread);
+        if (thread->count == thread->capacity && epoch_grow(thread) != 0)
+            return;
+    }
+    thread->retired[thread->count].ptr = ptr;
+    thread->retired[thread->count].epoch = __atomic_load_n(&g_epoch,
+                                                           __ATOMIC_ACQUIRE);
+    thread->count++;
+
+    if (++thread->pending >= EPOCH_BATCH)
+    {
+        thread->pending = 0;
+        epoch_try_advance();
+        epoch_release(thread);
+    }
+}
+
+size_t malloc_epoch_reclaim(void)
+{
+    t_epoch_thread *thread = t_epoch;
+
+    if (!thread)
+        return 0;
+    thread->pending = 0;
+    epoch_try_advance();
+    epoch_try_advance();
+    return epoch_release(thread);
+}
+
+__attribute__((constructor))
+static void epoch_init(void)
+{
+    g_epoch_key_ready =
+        pthread_key_create(&g_epoch_key, epoch_release_thread) == 0;
+}
@@ -1,35 +1,24 @@
 #include "malloc.h"
 
-void free(void *ptr)
+void release_block(t_zone *zone, t_block *block)
 {
-    t_zone *zone;
-    t_block *block;
-    
-    if (!ptr)
-        return;
-    
-    zone = find_zone_for_ptr(ptr);
-    if (!zone)
-        return;
-    
-    block = (t_block *)((char *)ptr - sizeof(t_block));
-    
-    // Check if already free
-    if (IS_FREE(block->size))
+    if (zone->type == MEDIUM_ZONE) {
+        medium_free(zone, block);
         return;
+    }
     
     // Mark block as free
-    block->size = SET_FREE(block->size);
+    block->size = SET_FREE(GET_SIZE(block->size));
     zone->free_blocks++;
     zone->free_size += GET_SIZE(block->size);
     
     // Coalesce with adjacent free blocks
-    coalesce_blocks(zone, block);
+    block = coalesce_blocks(zone, block);
     
     // For large zones, always unmap immediately
     if (zone->type == LARGE_ZONE) {
         remove_zone(&g_malloc_data.large_zones, zone);
-        munmap(zone, zone->size);
+        destroy_zone(zone);
         return;
     }
     
@@ -48,9 +37,104 @@ void free(void *ptr)
         
         // Only unmap if it's not the last zone of its type
         // This prevents thrashing (constantly creating/destroying zones)
-        if (head != zone || zone->next != NULL) {
+        // A draining zone takes no new blocks, so keeping it is pointless
+        if (head != zone || zone->next != NULL
+            || (zone->flags & ZONE_DRAINING)) {
             remove_zone(zone_list, zone);
-            munmap(zone, zone->size);
+            destroy_zone(zone);
+            return;
         }
     }
-}
\ No newline at end of file
+    
+    if (PURGE_ON_FREE)
+        g_malloc_data.stats.purged += purge_block(block);
+}
+
+void free_in_zone(t_zone *zone, void *ptr)
+{
+    t_block *block;
+    
+    // Region memory is only released with the region itself
+    if (zone->flags & ZONE_REGION)
+        return;
+    
+    g_latency_tier = zone->type;
+    block = (t_block *)((char *)ptr - sizeof(t_block));
+    
+    // Check if already free (or parked on a quick list)
+    if (IS_FREE(block->size) || IS_QUICK(block->size))
+    {
+#ifdef FT_FLAVOR_DEBUG
+        debug_report("double free", ptr);
+#endif
+        return;
+    }
+#ifdef FT_FLAVOR_DEBUG
+    debug_fill(ptr, GET_SIZE(block->size), DEBUG_FREE_BYTE);
+#endif
+    
+    // In deferred mode, keep the block as-is for the next request of the
+    // same size instead of coalescing it now
+    if (g_malloc_data.deferred && quick_push(zone, block))
+        return;
+    
+    release_block(zone, block);
+}
+
+void internal_free(void *ptr)
+{
+    t_zone *zone;
+    
+    if (!ptr)
+        return;
+    
+    zone = find_zone_for_ptr(ptr);
+    if (zone)
+        free_in_zone(zone, ptr);
+#ifdef FT_FLAVOR_DEBUG
+    else
+        debug_report("invalid pointer", ptr);
+#endif
+}
+
+void free(void *ptr)
+{
+    uint64_t start;
+    
+    if (g_malloc_data.tracing && ptr)
+        trace_record(TRACE_FREE, NULL, ptr, 0);
+    start = g_malloc_data.latency ? latency_begin() : 0;
+    g_latency_tier = -1;
+    internal_free(ptr);
+    // Unknown and region pointers have no tier to be recorded under
+    if (start && g_latency_tier >= 0)
+        latency_end(LAT_FREE, g_latency_tier, start);
+    if (g_malloc_data.shm)
+        shm_stats_tick(LAT_FREE);
+}
+
+
+void free_sized(void *ptr, size_t size)
+{
+    t_zone *zone;
+    uint64_t start;
+    
+    if (!ptr)
+        return;
+    if (g_malloc_data.tracing)
+        trace_record(TRACE_FREE, NULL, ptr, 0);
+    start = g_malloc_data.latency ? latency_begin() : 0;
+    g_latency_tier = -1;
+    
+    // The size tells us which tier to search; fall back to a full lookup
+    // if the caller passed a size from another tier
+    zone = find_zone_in_list(*get_zone_list(get_zone_type(ALIGN(size))), ptr);
+    if (!zone)
+        zone = find_zone_for_ptr(ptr);
+    if (zone)
+        free_in_zone(zone, ptr);
+    if (start && g_latency_tier >= 0)
+        latency_end(LAT_FREE, g_latency_tier, start);
+    if (g_malloc_data.shm)
+        shm_stats_tick(LAT_FREE);
+}
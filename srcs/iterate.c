@@ -0,0 +1,168 @@
+#include "malloc.h"
+
+// Growable array mapped outside the heap, so that the walk never changes
+// what it is looking at
+typedef struct s_scratch {
+    void    *data;
+    size_t  count;
+    size_t  capacity;   // In items
+} t_scratch;
+
+static int scratch_push(t_scratch *scratch, const void *item, size_t item_size)
+{
+    void *data;
+    size_t capacity;
+
+    if (scratch->count == scratch->capacity)
+    {
+        capacity = scratch->capacity ? scratch->capacity * 2
+                                     : getpagesize() / item_size;
+        data = mmap(NULL, capacity * item_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED)
+            return -1;
+        if (scratch->data)
+        {
+            ft_memcpy(data, scratch->data, scratch->count * item_size);
+            munmap(scratch->data, scratch->capacity * item_size);
+        }
+        scratch->data = data;
+        scratch->capacity = capacity;
+    }
+    ft_memcpy((char *)scratch->data + scratch->count * item_size, item,
+              item_size);
+    scratch->count++;
+    return 0;
+}
+
+static void scratch_release(t_scratch *scratch, size_t item_size)
+{
+    if (scratch->data)
+        munmap(scratch->data, scratch->capacity * item_size);
+}
+
+static int push_zones(t_scratch *zones, t_zone *zone)
+{
+    while (zone)
+    {
+        if (scratch_push(zones, &zone, sizeof(t_zone *)) != 0)
+            return -1;
+        zone = zone->next;
+    }
+    return 0;
+}
+
+// Tier lists first, then region zones, in show_alloc_mem order
+static int collect_zones(t_scratch *zones)
+{
+    t_region *region;
+    int type;
+
+    for (type = 0; type < ZONE_TYPES; type++)
+        if (push_zones(zones, *get_zone_list(type)) != 0)
+            return -1;
+    for (region = g_malloc_data.regions; region; region = region->next)
+        if (push_zones(zones, region->zones) != 0)
+            return -1;
+    return 0;
+}
+
+static int zone_in_list(t_zone *list, t_zone *zone)
+{
+    while (list && list != zone)
+        list = list->next;
+    return list != NULL;
+}
+
+// Compares addresses only: a released zone must not be dereferenced
+static int zone_is_live(t_zone *zone)
+{
+    t_region *region;
+    int type;
+
+    for (type = 0; type < ZONE_TYPES; type++)
+        if (zone_in_list(*get_zone_list(type), zone))
+            return 1;
+    for (region = g_malloc_data.regions; region; region = region->next)
+        if (zone_in_list(region->zones, zone))
+            return 1;
+    return 0;
+}
+
+// Copy one zone's entries. This is the only part of the walk that reads
+// allocator state; visitors run afterwards, on the copy.
+static int snapshot_zone(t_zone *zone, int what, t_scratch *entries)
+{
+    t_heap_entry entry;
+    t_block *block;
+    char *zone_end;
+    size_t block_size;
+
+    entries->count = 0;
+    entry.zone = zone;
+    entry.zone_size = zone->size;
+    entry.type = zone->type;
+    entry.flags = zone->flags;
+    if (what & HEAP_VISIT_ZONES)
+    {
+        entry.kind = HEAP_ZONE;
+        entry.ptr = zone;
+        entry.size = zone->size;
+        if (scratch_push(entries, &entry, sizeof(entry)) != 0)
+            return -1;
+    }
+
+    zone_end = (char *)zone + zone->size;
+    block = zone_first_block(zone);
+    while ((char *)block < zone_end)
+    {
+        block_size = GET_SIZE(block->size);
+        if (block_size == 0
+            || (char *)block + BLOCK_HEADER_SIZE + block_size > zone_end)
+            break;
+        entry.kind = (IS_FREE(block->size) || IS_QUICK(block->size))
+                     ? HEAP_FREE : HEAP_LIVE;
+        entry.ptr = (char *)block + BLOCK_HEADER_SIZE;
+        entry.size = block_size;
+        if ((what & (1 << entry.kind))
+            && scratch_push(entries, &entry, sizeof(entry)) != 0)
+            return -1;
+        block = (t_block *)((char *)block + BLOCK_HEADER_SIZE + block_size);
+    }
+    return 0;
+}
+
+size_t malloc_iterate(int what, t_heap_visitor visitor, void *arg)
+{
+    t_scratch zones = {0};
+    t_scratch entries = {0};
+    t_zone *zone;
+    size_t destroyed;
+    size_t visited = 0;
+    size_t i;
+    size_t j;
+    int stop = 0;
+
+    if (!visitor || collect_zones(&zones) != 0)
+    {
+        scratch_release(&zones, sizeof(t_zone *));
+        return 0;
+    }
+
+    destroyed = g_malloc_data.stats.destroyed;
+    for (i = 0; i < zones.count && !stop; i++)
+    {
+        // A visitor may have freed the last block of a zone further on
+        zone = ((t_zone **)zones.data)[i];
+        if (g_malloc_data.stats.destroyed != destroyed && !zone_is_live(zone))
+            continue;
+        if (snapshot_zone(zone, what, &entries) != 0)
+            break;
+        for (j = 0; j < entries.count && !stop; j++, visited++)
+            stop = visitor(&((t_heap_entry *)entries.data)[j], arg);
+    }
+
+    scratch_release(&entries, sizeof(t_heap_entry));
+    scratch_release(&zones, sizeof(t_zone *));
+    return visited;
+}
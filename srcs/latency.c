@@ -0,0 +1,310 @@
+#include "malloc.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+#endif
+
+// Per-thread histograms. Only the owning thread writes its counters, with
+// relaxed loads/stores, so recording never takes a lock or a locked
+// instruction. A reset bumps the global generation; each thread clears its
+// own counters the next time it records, and snapshots skip stale blocks.
+typedef struct s_latency_block {
+    struct s_latency_block  *next;      // Registry link, never unlinked
+    int                     in_use;
+    unsigned                generation;
+    uint64_t                counts[LAT_OPS][ZONE_TYPES][LAT_PATHS][LAT_BUCKETS];
+} t_latency_block;
+
+__thread int                g_latency_path = LAT_PATH_HIT;
+__thread int                g_latency_tier = TINY_ZONE;
+
+static t_latency_block      *g_latency_blocks = NULL;
+static unsigned             g_latency_generation = 0;
+static uint64_t             g_ticks_per_us = 1000;
+static pthread_key_t        g_latency_key;
+static int                  g_latency_key_ready = 0;
+
+static __thread t_latency_block *t_latency = NULL;
+
+static inline uint64_t read_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+
+    __asm__ volatile ("mrs %0, cntvct_el0" : "=r" (ticks));
+    return ticks;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Measure the tick rate against CLOCK_MONOTONIC over ~1ms
+static void latency_calibrate(void)
+{
+    uint64_t ticks;
+    uint64_t start;
+    uint64_t elapsed;
+
+    ticks = read_ticks();
+    start = now_ns();
+    while ((elapsed = now_ns() - start) < 1000000)
+        ;
+    ticks = read_ticks() - ticks;
+    g_ticks_per_us = ticks * 1000 / elapsed;
+    if (g_ticks_per_us == 0)
+        g_ticks_per_us = 1;
+}
+
+static int latency_bucket(uint64_t ticks)
+{
+    int msb;
+
+    if (ticks < (1 << LAT_SUB_BITS))
+        return (int)ticks;
+    msb = 63 - __builtin_clzll(ticks);
+    return ((msb - LAT_SUB_BITS + 1) << LAT_SUB_BITS)
+           + (int)((ticks >> (msb - LAT_SUB_BITS)) & ((1 << LAT_SUB_BITS) - 1));
+}
+
+// Largest tick count that falls into a bucket
+static uint64_t latency_bucket_max(int bucket)
+{
+    int msb;
+    uint64_t low;
+
+    if (bucket < (1 << LAT_SUB_BITS))
+        return (uint64_t)bucket;
+    msb = (bucket >> LAT_SUB_BITS) + LAT_SUB_BITS - 1;
+    low = (1ULL << msb)
+          + ((uint64_t)(bucket & ((1 << LAT_SUB_BITS) - 1)) << (msb - LAT_SUB_BITS));
+    return low + (1ULL << (msb - LAT_SUB_BITS)) - 1;
+}
+
+static void latency_release_block(void *arg)
+{
+    t_latency_block *block = arg;
+
+    __atomic_store_n(&block->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static t_latency_block *latency_claim_block(void)
+{
+    t_latency_block *block;
+    int expected;
+
+    // Reuse a block left behind by an exited thread, keeping its counts
+    block = __atomic_load_n(&g_latency_blocks, __ATOMIC_ACQUIRE);
+    while (block)
+    {
+        expected = 0;
+        if (__atomic_compare_exchange_n(&block->in_use, &expected, 1, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            break;
+        block = block->next;
+    }
+
+    if (!block)
+    {
+        block = mmap(NULL, sizeof(t_latency_block), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (block == MAP_FAILED)
+            return NULL;
+        block->in_use = 1;
+        block->generation = __atomic_load_n(&g_latency_generation,
+                                            __ATOMIC_ACQUIRE);
+        block->next = __atomic_load_n(&g_latency_blocks, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&g_latency_blocks, &block->next,
+                                            block, 0, __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED))
+            ;
+    }
+
+    if (g_latency_key_ready)
+        pthread_setspecific(g_latency_key, block);
+    return block;
+}
+
+uint64_t latency_begin(void)
+{
+    g_latency_path = LAT_PATH_HIT;
+    return read_ticks() | 1;
+}
+
+void latency_path(int path)
+{
+    if (path > g_latency_path)
+        g_latency_path = path;
+}
+
+void latency_end(int op, int tier, uint64_t start)
+{
+    t_latency_block *block;
+    uint64_t *counter;
+    unsigned generation;
+
+    block = t_latency;
+    if (!block)
+        block = t_latency = latency_claim_block();
+    if (!block)
+        return;
+
+    generation = __atomic_load_n(&g_latency_generation, __ATOMIC_ACQUIRE);
+    if (block->generation != generation)
+    {
+        ft_bzero(block->counts, sizeof(block->counts));
+        __atomic_store_n(&block->generation, generation, __ATOMIC_RELEASE);
+    }
+
+    counter = &block->counts[op][tier][g_latency_path]
+                            [latency_bucket(read_ticks() - start)];
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + 1,
+                     __ATOMIC_RELAXED);
+}
+
+void malloc_latency_enable(int enable)
+{
+    if (enable && !g_latency_key_ready)
+    {
+        latency_calibrate();
+        g_latency_key_ready =
+            pthread_key_create(&g_latency_key, latency_release_block) == 0;
+    }
+    g_malloc_data.latency = enable != 0;
+}
+
+void malloc_latency_snapshot(t_latency_snapshot *snapshot)
+{
+    t_latency_block *block;
+    uint64_t *dst;
+    uint64_t *src;
+    unsigned generation;
+    size_t count;
+    size_t i;
+
+    ft_bzero(snapshot, sizeof(t_latency_snapshot));
+    snapshot->ticks_per_us = g_ticks_per_us;
+    generation = __atomic_load_n(&g_latency_generation, __ATOMIC_ACQUIRE);
+    count = sizeof(snapshot->counts) / sizeof(uint64_t);
+
+    block = __atomic_load_n(&g_latency_blocks, __ATOMIC_ACQUIRE);
+    while (block)
+    {
+        if (__atomic_load_n(&block->generation, __ATOMIC_ACQUIRE) == generation)
+        {
+            dst = &snapshot->counts[0][0][0][0];
+            src = &block->counts[0][0][0][0];
+            for (i = 0; i < count; i++)
+                dst[i] += __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+        }
+        block = block->next;
+    }
+}
+
+void malloc_latency_reset(void)
+{
+    __atomic_add_fetch(&g_latency_generation, 1, __ATOMIC_RELEASE);
+}
+
+uint64_t malloc_latency_percentile(const uint64_t *buckets, double percentile)
+{
+    uint64_t total = 0;
+    uint64_t target;
+    uint64_t seen = 0;
+    int i;
+
+    for (i = 0; i < LAT_BUCKETS; i++)
+        total += buckets[i];
+    if (total == 0)
+        return 0;
+
+    target = (uint64_t)((double)total * percentile / 100.0);
+    if (target == 0)
+        target = 1;
+    for (i = 0; i < LAT_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen >= target)
+            return latency_bucket_max(i);
+    }
+    return latency_bucket_max(LAT_BUCKETS - 1);
+}
+
+static void print_latency_ns(const char *label, uint64_t ticks, uint64_t per_us)
+{
+    ft_putstr(label);
+    ft_putnbr(ticks * 1000 / per_us);
+    ft_putstr("ns");
+}
+
+void show_alloc_latency(void)
+{
+    static const char *ops[LAT_OPS] = {"malloc", "free", "realloc"};
+    static const char *tiers[ZONE_TYPES] = {"TINY", "SMALL", "MEDIUM", "LARGE"};
+    static const char *paths[LAT_PATHS] = {"hit", "new zone", "syscall"};
+    t_latency_snapshot *snapshot;
+    uint64_t *buckets;
+    uint64_t total;
+    int op, tier, path, i;
+
+    snapshot = mmap(NULL, sizeof(t_latency_snapshot), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (snapshot == MAP_FAILED)
+        return;
+    malloc_latency_snapshot(snapshot);
+
+    for (op = 0; op < LAT_OPS; op++)
+        for (tier = 0; tier < ZONE_TYPES; tier++)
+            for (path = 0; path < LAT_PATHS; path++)
+            {
+                buckets = snapshot->counts[op][tier][path];
+                total = 0;
+                for (i = 0; i < LAT_BUCKETS; i++)
+                    total += buckets[i];
+                if (total == 0)
+                    continue;
+                ft_putstr(ops[op]);
+                ft_putstr(" ");
+                ft_putstr(tiers[tier]);
+                ft_putstr(" ");
+                ft_putstr(paths[path]);
+                ft_putstr(" : ");
+                ft_putnbr(total);
+                ft_putstr(" calls");
+                print_latency_ns(", p50 ",
+                    malloc_latency_percentile(buckets, 50.0), snapshot->ticks_per_us);
+                print_latency_ns(", p99 ",
+                    malloc_latency_percentile(buckets, 99.0), snapshot->ticks_per_us);
+                print_latency_ns(", p99.9 ",
+                    malloc_latency_percentile(buckets, 99.9), snapshot->ticks_per_us);
+                print_latency_ns(", max ",
+                    malloc_latency_percentile(buckets, 100.0), snapshot->ticks_per_us);
+                ft_putstr("\n");
+            }
+
+    munmap(snapshot, sizeof(t_latency_snapshot));
+}
+
+__attribute__((constructor))
+static void latency_init(void)
+{
+    const char *value;
+
+    value = getenv("FT_MALLOC_LATENCY");
+    if (value && *value && *value != '0')
+        malloc_latency_enable(1);
+}
@@ -0,0 +1,78 @@
+#include "malloc.h"
+
+// Free block closest to `hint`. Blocks come in address order, so the walk
+// stops at the first fitting block past the hint; a block before it is
+// measured from its end, which is where the allocation will be carved.
+static t_block *nearest_fit(t_zone *zone, char *hint, size_t size)
+{
+    t_block *block;
+    t_block *best = NULL;
+    char *zone_end;
+    size_t block_size;
+    size_t best_distance = (size_t)-1;
+
+    zone_end = (char *)zone + zone->size;
+    block = zone_first_block(zone);
+    while ((char *)block < zone_end)
+    {
+        block_size = GET_SIZE(block->size);
+        if (block_size == 0
+            || (char *)block + BLOCK_HEADER_SIZE + block_size > zone_end)
+            break;
+        if (IS_FREE(block->size) && block_size >= size)
+        {
+            if ((char *)block > hint)
+                return (size_t)((char *)block - hint) < best_distance
+                       ? block : best;
+            best = block;
+            best_distance = hint - ((char *)block + BLOCK_HEADER_SIZE
+                                    + block_size);
+        }
+        block = (t_block *)((char *)block + BLOCK_HEADER_SIZE + block_size);
+    }
+    return best;
+}
+
+static void *allocate_near(void *hint, size_t size)
+{
+    t_zone *zone;
+    t_block *block;
+
+    zone = find_zone_for_ptr(hint);
+    if (!zone || zone->type != get_zone_type(size) || zone->type == LARGE_ZONE
+        || (zone->flags & (ZONE_REGION | ZONE_DRAINING))
+        || zone->free_size < size)
+        return NULL;
+
+    // Page runs have no notion of distance; same zone is the best we get
+    if (zone->type == MEDIUM_ZONE)
+        return medium_alloc(zone, size);
+
+    block = nearest_fit(zone, hint, size);
+    if (!block)
+        return NULL;
+    return allocate_block(zone, block, size, (char *)block < (char *)hint);
+}
+
+void *malloc_near(void *hint, size_t size)
+{
+    void *ptr = NULL;
+    uint64_t start;
+
+    start = g_malloc_data.latency ? latency_begin() : 0;
+    if (hint && size)
+        ptr = allocate_near(hint, ALIGN(size));
+#ifdef FT_FLAVOR_DEBUG
+    if (ptr)
+        debug_fill(ptr, ALIGN(size), DEBUG_ALLOC_BYTE);
+#endif
+    if (!ptr)
+        ptr = internal_malloc(size);
+    if (start)
+        latency_end(LAT_MALLOC, get_zone_type(ALIGN(size)), start);
+    if (g_malloc_data.tracing)
+        trace_record(TRACE_MALLOC, ptr, NULL, size);
+    if (g_malloc_data.shm)
+        shm_stats_tick(LAT_MALLOC);
+    return ptr;
+}
@@ -1,59 +1,90 @@
 #include "malloc.h"
 
-t_malloc_data g_malloc_data = {NULL, NULL, NULL};
+t_malloc_data g_malloc_data = {0};
 
-static int get_zone_type(size_t size)
+// Tier dispatch tables, fixed at compile time for the build flavor.
+// g_size_tier maps every ALIGNMENT-sized class up to SMALL_MAX to its tier.
+static const unsigned char g_size_tier[SMALL_MAX / ALIGNMENT + 1] = {
+    [0 ... TINY_MAX / ALIGNMENT] = TINY_ZONE,
+    [TINY_MAX / ALIGNMENT + 1 ... SMALL_MAX / ALIGNMENT] = SMALL_ZONE,
+};
+
+static t_zone **const g_zone_lists[ZONE_TYPES] = {
+    &g_malloc_data.tiny_zones,
+    &g_malloc_data.small_zones,
+    &g_malloc_data.medium_zones,
+    &g_malloc_data.large_zones,
+};
+
+static const size_t g_zone_pages[ZONE_TYPES] = {
+    TINY_ZONE_PAGES,
+    SMALL_ZONE_PAGES,
+    MEDIUM_ZONE_PAGES,
+    0,
+};
+
+int get_zone_type(size_t size)
 {
-    if (size <= TINY_MAX)
-        return TINY_ZONE;
-    else if (size <= SMALL_MAX)
-        return SMALL_ZONE;
-    return LARGE_ZONE;
+    if (size > SMALL_MAX)
+    {
+        if (size <= g_malloc_data.classes.small_max)
+            return SMALL_ZONE;
+        return size <= MEDIUM_MAX ? MEDIUM_ZONE : LARGE_ZONE;
+    }
+    return g_size_tier[(size + ALIGNMENT - 1) / ALIGNMENT];
 }
 
-static t_zone **get_zone_list(int type)
+t_zone **get_zone_list(int type)
 {
-    if (type == TINY_ZONE)
-        return &g_malloc_data.tiny_zones;
-    else if (type == SMALL_ZONE)
-        return &g_malloc_data.small_zones;
-    return &g_malloc_data.large_zones;
+    return g_zone_lists[type];
 }
 
-static size_t get_zone_size(int type, size_t size)
+size_t get_zone_size(int type, size_t size)
 {
-    if (type == TINY_ZONE)
-        return TINY_ZONE_SIZE;
-    else if (type == SMALL_ZONE)
-        return SMALL_ZONE_SIZE;
+    if (g_zone_pages[type])
+        return g_zone_pages[type] * getpagesize();
     // For large allocations, allocate exact size + headers
     return ALIGN(size + ZONE_HEADER_SIZE + BLOCK_HEADER_SIZE);
 }
 
-void *malloc(size_t size)
+static void *search_zones(t_zone *zone, size_t size, int skip_flags)
 {
     void *ptr;
-    int type;
-    t_zone **zone_list;
-    t_zone *zone;
-    
-    if (size == 0)
-        return NULL;
     
-    // Align size
-    size = ALIGN(size);
+    while (zone)
+    {
+        if (!(zone->flags & skip_flags))
+        {
+            ptr = allocate_in_zone(zone, size);
+            if (ptr)
+                return ptr;
+        }
+        zone = zone->next;
+    }
     
-    type = get_zone_type(size);
-    zone_list = get_zone_list(type);
+    return NULL;
+}
+
+void *allocate_in_list(t_zone **zone_list, int type, size_t size,
+                       int skip_flags)
+{
+    void *ptr;
+    t_zone *zone;
     
     // Try to find space in existing zones
-    zone = *zone_list;
-    while (zone && type != LARGE_ZONE)
+    if (type != LARGE_ZONE)
     {
-        ptr = allocate_in_zone(zone, size);
+        ptr = search_zones(*zone_list, size, skip_flags);
+        
+        // On a miss, coalesce the blocks parked on the quick lists and
+        // look again before mapping a new zone
+        if (!ptr && type != MEDIUM_ZONE && g_malloc_data.quick.total)
+        {
+            malloc_flush_deferred();
+            ptr = search_zones(*zone_list, size, skip_flags);
+        }
         if (ptr)
             return ptr;
-        zone = zone->next;
     }
     
     // Create new zone
@@ -65,4 +96,48 @@ void *malloc(size_t size)
     ptr = allocate_in_zone(zone, size);
     
     return ptr;
-}
\ No newline at end of file
+}
+
+void *internal_malloc(size_t size)
+{
+    void *ptr;
+    int type;
+    
+    if (size == 0)
+        return NULL;
+    
+    if (g_malloc_data.classes.adaptive && size > SMALL_MAX
+        && size <= CLASS_LIMIT)
+        class_sample(size);
+    
+    // Align size
+    size = ALIGN(size);
+    
+    type = get_zone_type(size);
+    ptr = NULL;
+    if (g_malloc_data.deferred && type <= SMALL_ZONE)
+        ptr = quick_pop(size);
+    if (!ptr)
+        ptr = allocate_in_list(get_zone_list(type), type, size, 0);
+#ifdef FT_FLAVOR_DEBUG
+    if (ptr)
+        debug_fill(ptr, size, DEBUG_ALLOC_BYTE);
+#endif
+    return ptr;
+}
+
+void *malloc(size_t size)
+{
+    void *ptr;
+    uint64_t start;
+    
+    start = g_malloc_data.latency ? latency_begin() : 0;
+    ptr = internal_malloc(size);
+    if (start)
+        latency_end(LAT_MALLOC, get_zone_type(ALIGN(size)), start);
+    if (g_malloc_data.tracing)
+        trace_record(TRACE_MALLOC, ptr, NULL, size);
+    if (g_malloc_data.shm)
+        shm_stats_tick(LAT_MALLOC);
+    return ptr;
+}
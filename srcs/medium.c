@@ -0,0 +1,210 @@
+#include "malloc.h"
+
+#define MEDIUM(zone)    ((t_medium *)((char *)(zone) + ZONE_HEADER_SIZE))
+
+static size_t run_bin(size_t pages)
+{
+    return pages < MEDIUM_BINS - 1 ? pages : MEDIUM_BINS - 1;
+}
+
+static t_block *run_block(t_zone *zone, uint32_t index)
+{
+    size_t page = getpagesize();
+
+    return (t_block *)((char *)zone + (MEDIUM(zone)->first + index) * page);
+}
+
+static void set_run(t_medium *medium, uint32_t index, uint32_t pages,
+                    uint32_t flags)
+{
+    medium->map[index].pages = pages;
+    medium->map[index].flags = flags;
+    medium->map[index + pages - 1].pages = pages;
+    medium->map[index + pages - 1].flags = flags;
+}
+
+// Forget a run boundary once it is merged into a bigger run
+static void clear_run(t_medium *medium, uint32_t index, uint32_t pages)
+{
+    medium->map[index].pages = 0;
+    medium->map[index].flags = 0;
+    medium->map[index + pages - 1].pages = 0;
+    medium->map[index + pages - 1].flags = 0;
+}
+
+static void insert_free(t_zone *zone, uint32_t index, uint32_t pages)
+{
+    t_medium *medium = MEDIUM(zone);
+    t_block *block;
+    size_t bin;
+    size_t page = getpagesize();
+
+    set_run(medium, index, pages, RUN_FREE);
+    bin = run_bin(pages);
+    medium->map[index].prev = RUN_NONE;
+    medium->map[index].next = medium->bins[bin];
+    if (medium->bins[bin] != RUN_NONE)
+        medium->map[medium->bins[bin]].prev = index;
+    medium->bins[bin] = index;
+    medium->bitmap[bin / 64] |= 1ULL << (bin % 64);
+
+    // Keep the block view of the zone walkable
+    block = run_block(zone, index);
+    block->size = SET_FREE(pages * page - BLOCK_HEADER_SIZE);
+    block->prev_size = 0;
+
+    zone->free_blocks++;
+    zone->free_size += pages * page;
+}
+
+static void remove_free(t_zone *zone, uint32_t index)
+{
+    t_medium *medium = MEDIUM(zone);
+    t_run *run = &medium->map[index];
+    size_t bin;
+
+    bin = run_bin(run->pages);
+    if (run->prev != RUN_NONE)
+        medium->map[run->prev].next = run->next;
+    else
+        medium->bins[bin] = run->next;
+    if (run->next != RUN_NONE)
+        medium->map[run->next].prev = run->prev;
+    if (medium->bins[bin] == RUN_NONE)
+        medium->bitmap[bin / 64] &= ~(1ULL << (bin % 64));
+
+    zone->free_blocks--;
+    zone->free_size -= (size_t)run->pages * getpagesize();
+}
+
+// Smallest non-empty bin that can hold `pages`, RUN_NONE if there is none
+static uint32_t find_free(t_medium *medium, uint32_t pages)
+{
+    uint64_t word;
+    uint32_t index;
+    size_t bin;
+    size_t w;
+
+    bin = run_bin(pages);
+    for (w = bin / 64; w < (MEDIUM_BINS + 63) / 64; w++)
+    {
+        word = medium->bitmap[w];
+        if (w == bin / 64)
+            word &= ~0ULL << (bin % 64);
+        if (word)
+            break;
+    }
+    if (w == (MEDIUM_BINS + 63) / 64)
+        return RUN_NONE;
+    bin = w * 64 + __builtin_ctzll(word);
+    if (bin < MEDIUM_BINS - 1)
+        return medium->bins[bin];
+
+    // The last bin mixes lengths: first fit
+    index = medium->bins[MEDIUM_BINS - 1];
+    while (index != RUN_NONE && medium->map[index].pages < pages)
+        index = medium->map[index].next;
+    return index;
+}
+
+void medium_init_zone(t_zone *zone)
+{
+    t_medium *medium = MEDIUM(zone);
+    size_t page = getpagesize();
+    size_t total;
+    size_t meta;
+    size_t i;
+
+    // The page map is sized for the whole zone, which leaves a few
+    // entries unused but avoids solving for its own size
+    total = zone->size / page;
+    meta = (ZONE_HEADER_SIZE + sizeof(t_medium) + total * sizeof(t_run)
+            + page - 1) / page;
+    medium->first = (uint32_t)meta;
+    medium->pages = (uint32_t)(total - meta);
+    for (i = 0; i < MEDIUM_BINS; i++)
+        medium->bins[i] = RUN_NONE;
+    ft_bzero(medium->bitmap, sizeof(medium->bitmap));
+
+    zone->free_blocks = 0;
+    zone->free_size = 0;
+    insert_free(zone, 0, medium->pages);
+}
+
+void *medium_alloc(t_zone *zone, size_t size)
+{
+    t_medium *medium = MEDIUM(zone);
+    t_block *block;
+    uint32_t index;
+    uint32_t pages;
+    uint32_t found;
+    size_t page = getpagesize();
+
+    pages = (uint32_t)((size + BLOCK_HEADER_SIZE + page - 1) / page);
+    index = find_free(medium, pages);
+    if (index == RUN_NONE)
+        return NULL;
+
+    // Take the front of the run and give the rest back
+    found = medium->map[index].pages;
+    remove_free(zone, index);
+    clear_run(medium, index, found);
+    if (found > pages)
+        insert_free(zone, index + pages, found - pages);
+    set_run(medium, index, pages, 0);
+
+    block = run_block(zone, index);
+    block->size = pages * page - BLOCK_HEADER_SIZE;
+    block->prev_size = 0;
+    return (char *)block + BLOCK_HEADER_SIZE;
+}
+
+void medium_free(t_zone *zone, t_block *block)
+{
+    t_medium *medium = MEDIUM(zone);
+    uint32_t index;
+    uint32_t pages;
+    uint32_t next;
+    uint32_t prev;
+    size_t page = getpagesize();
+
+    // Only the start of an allocated run is a valid pointer
+    if (((uintptr_t)block & (page - 1)) != 0)
+        return;
+    index = (uint32_t)(((char *)block - (char *)run_block(zone, 0)) / page);
+    if (index >= medium->pages)
+        return;
+    pages = medium->map[index].pages;
+    if (pages == 0 || (medium->map[index].flags & RUN_FREE)
+        || GET_SIZE(block->size) != pages * page - BLOCK_HEADER_SIZE)
+        return;
+    clear_run(medium, index, pages);
+
+    // Merge with the free runs on either side
+    next = index + pages;
+    if (next < medium->pages && (medium->map[next].flags & RUN_FREE))
+    {
+        remove_free(zone, next);
+        pages += medium->map[next].pages;
+        clear_run(medium, next, medium->map[next].pages);
+    }
+    if (index > 0 && (medium->map[index - 1].flags & RUN_FREE))
+    {
+        prev = index - medium->map[index - 1].pages;
+        remove_free(zone, prev);
+        pages += medium->map[prev].pages;
+        clear_run(medium, prev, medium->map[prev].pages);
+        index = prev;
+    }
+    insert_free(zone, index, pages);
+
+    // Same policy as TINY/SMALL: keep the last zone of the tier
+    if (zone_is_empty(zone)
+        && (g_malloc_data.medium_zones != zone || zone->next))
+    {
+        remove_zone(&g_malloc_data.medium_zones, zone);
+        destroy_zone(zone);
+    }
+    else if (PURGE_ON_FREE)
+        g_malloc_data.stats.purged += purge_block(run_block(zone, index));
+}
@@ -0,0 +1,181 @@
+#include "malloc_resource.hpp"
+
+// Replaceable operator new/delete. Sizes and alignments are passed straight
+// to the allocator: aligned forms use aligned_alloc(), and sized deletes
+// only search the zone tier that the size belongs to.
+
+static void *try_allocate(std::size_t size, std::size_t alignment)
+{
+    if (size == 0)
+        size = 1;
+    if (alignment > ALIGNMENT)
+        return aligned_alloc(alignment, size);
+    return malloc(size);
+}
+
+void *ft::allocate(std::size_t size, std::size_t alignment)
+{
+    void *ptr;
+    std::new_handler handler;
+
+    while (!(ptr = try_allocate(size, alignment)))
+    {
+        handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+    return ptr;
+}
+
+void ft::deallocate(void *ptr, std::size_t size, std::size_t alignment) noexcept
+{
+    if (size == 0)
+        size = 1;
+    free_aligned_sized(ptr, alignment, size);
+}
+
+static void *allocate_nothrow(std::size_t size, std::size_t alignment) noexcept
+{
+    try
+    {
+        return ft::allocate(size, alignment);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+// Plain forms
+void *operator new(std::size_t size)
+{
+    return ft::allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new[](std::size_t size)
+{
+    return ft::allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate_nothrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate_nothrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t size) noexcept
+{
+    ft::deallocate(ptr, size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete[](void *ptr, std::size_t size) noexcept
+{
+    ft::deallocate(ptr, size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+// Aligned forms
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return ft::allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return ft::allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment,
+                   const std::nothrow_t &) noexcept
+{
+    return allocate_nothrow(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment,
+                     const std::nothrow_t &) noexcept
+{
+    return allocate_nothrow(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t,
+                     const std::nothrow_t &) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t,
+                       const std::nothrow_t &) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t size,
+                     std::align_val_t alignment) noexcept
+{
+    ft::deallocate(ptr, size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void *ptr, std::size_t size,
+                       std::align_val_t alignment) noexcept
+{
+    ft::deallocate(ptr, size, static_cast<std::size_t>(alignment));
+}
+
+// std::pmr adapter
+void *ft::malloc_resource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    return ft::allocate(bytes, alignment);
+}
+
+void ft::malloc_resource::do_deallocate(void *ptr, std::size_t bytes,
+                                        std::size_t alignment)
+{
+    ft::deallocate(ptr, bytes, alignment);
+}
+
+bool ft::malloc_resource::do_is_equal(
+    const std::pmr::memory_resource &other) const noexcept
+{
+    return dynamic_cast<const ft::malloc_resource *>(&other) != nullptr;
+}
+
+std::pmr::memory_resource *ft::malloc_memory_resource() noexcept
+{
+    static ft::malloc_resource resource;
+
+    return &resource;
+}
@@ -0,0 +1,393 @@
+#include "malloc.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+# define MAP_FIXED_NOREPLACE    0x100000
+#endif
+
+#define PHEAP_FIRST(h)  ((t_zone *)((char *)(h) + (h)->page_size))
+#define PHEAP_END(h)    ((t_zone *)((char *)(h) + (h)->size))
+
+static uint32_t header_checksum(const t_pheap_header *header)
+{
+    const unsigned char *byte = (const unsigned char *)header;
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < offsetof(t_pheap_header, checksum); i++)
+        hash = (hash ^ byte[i]) * 16777619u;
+    return hash;
+}
+
+static void header_seal(t_pheap_header *header)
+{
+    header->checksum = header_checksum(header);
+}
+
+static t_zone *next_zone(t_zone *zone)
+{
+    return (t_zone *)((char *)zone + zone->size);
+}
+
+static t_zone *pheap_find_zone(t_pheap *heap, void *ptr)
+{
+    t_pheap_header *header = heap->header;
+    t_zone *zone;
+
+    if ((char *)ptr < (char *)PHEAP_FIRST(header)
+        || (char *)ptr >= (char *)PHEAP_END(header))
+        return NULL;
+    zone = PHEAP_FIRST(header);
+    while (zone < PHEAP_END(header) && (char *)ptr >= (char *)next_zone(zone))
+        zone = next_zone(zone);
+    return zone;
+}
+
+// Append a zone to the file. It is initialized before the header's size
+// covers it, so a crash in between leaves only unused file space behind.
+static t_zone *pheap_grow(t_pheap *heap, size_t size)
+{
+    t_pheap_header *header = heap->header;
+    t_zone *zone;
+    size_t page = header->page_size;
+    size_t zone_size;
+
+    zone_size = (size + ZONE_HEADER_SIZE + BLOCK_HEADER_SIZE + page - 1)
+                & ~(page - 1);
+    if (zone_size < PHEAP_ZONE_PAGES * page)
+        zone_size = PHEAP_ZONE_PAGES * page;
+    if (zone_size > header->span - header->size)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (ftruncate(heap->fd, header->size + zone_size) != 0)
+        return NULL;
+
+    // The range is inside our own reservation, so MAP_FIXED is safe here
+    zone = PHEAP_END(header);
+    if (mmap(zone, zone_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+             heap->fd, header->size) == MAP_FAILED)
+        return NULL;
+    init_zone(zone, zone_size, SMALL_ZONE);
+    zone->flags = ZONE_PERSISTENT;
+
+    header->size += zone_size;
+    header_seal(header);
+    return zone;
+}
+
+static int check_header(t_pheap_header *header, size_t file_size)
+{
+    size_t page = getpagesize();
+
+    return ft_memcmp(header->magic, PHEAP_MAGIC, sizeof(header->magic)) == 0
+        && header->version == PHEAP_VERSION
+        && header->page_size == page
+        && header->zone_header == ZONE_HEADER_SIZE
+        && header->block_header == BLOCK_HEADER_SIZE
+        && header->checksum == header_checksum(header)
+        && header->base == (uint64_t)(uintptr_t)header
+        && header->size >= page && header->size % page == 0
+        && header->size <= header->span && header->size <= file_size;
+}
+
+// Walk every block of a zone: sizes tile the zone exactly, prev_size links
+// match, free blocks are coalesced and the zone's counters add up (free_size
+// is the capacity minus live payload, free block headers included)
+static int check_blocks(t_zone *zone, uint64_t root, int *root_found)
+{
+    t_block *block;
+    char *end = (char *)zone + zone->size;
+    size_t free_blocks = 0;
+    size_t used_size = 0;
+    size_t prev_size = 0;
+    size_t size;
+    int prev_free = 0;
+
+    block = (t_block *)((char *)zone + ZONE_HEADER_SIZE);
+    while ((char *)block < end)
+    {
+        size = GET_SIZE(block->size);
+        if (size == 0 || size % ALIGNMENT != 0
+            || size > (size_t)(end - (char *)block) - BLOCK_HEADER_SIZE
+            || block->prev_size != prev_size || IS_QUICK(block->size))
+            return 0;
+        if (IS_FREE(block->size))
+        {
+            if (prev_free)
+                return 0;
+            free_blocks++;
+        }
+        else
+        {
+            used_size += size;
+            if (root == (uint64_t)(uintptr_t)block + BLOCK_HEADER_SIZE)
+                *root_found = 1;
+        }
+        prev_free = IS_FREE(block->size);
+        prev_size = size;
+        block = (t_block *)((char *)block + BLOCK_HEADER_SIZE + size);
+    }
+    return (char *)block == end && free_blocks == zone->free_blocks
+        && used_size + zone->free_size == zone_capacity(zone);
+}
+
+static int check_zones(t_pheap_header *header, int blocks)
+{
+    t_zone *zone;
+    size_t left;
+    int root_found = 0;
+
+    zone = PHEAP_FIRST(header);
+    while (zone < PHEAP_END(header))
+    {
+        left = (char *)PHEAP_END(header) - (char *)zone;
+        if (zone->size < header->page_size || zone->size > left
+            || zone->size % header->page_size != 0
+            || zone->type != SMALL_ZONE || zone->flags != ZONE_PERSISTENT)
+            return 0;
+        if (blocks && !check_blocks(zone, header->root, &root_found))
+            return 0;
+        zone = next_zone(zone);
+    }
+    if (header->root == 0)
+        return 1;
+    if (blocks)
+        return root_found;
+    return header->root > (uint64_t)(uintptr_t)PHEAP_FIRST(header)
+        && header->root < (uint64_t)(uintptr_t)PHEAP_END(header);
+}
+
+static int pheap_create(t_pheap_header *header, int fd, size_t span)
+{
+    size_t page = getpagesize();
+
+    if (ftruncate(fd, page) != 0
+        || mmap(header, page, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                fd, 0) == MAP_FAILED)
+        return -1;
+    ft_bzero(header, sizeof(t_pheap_header));
+    ft_memcpy(header->magic, PHEAP_MAGIC, sizeof(header->magic));
+    header->version = PHEAP_VERSION;
+    header->page_size = page;
+    header->zone_header = ZONE_HEADER_SIZE;
+    header->block_header = BLOCK_HEADER_SIZE;
+    header->base = (uint64_t)(uintptr_t)header;
+    header->span = span;
+    header->size = page;
+    header->dirty = 1;
+    header_seal(header);
+    return 0;
+}
+
+// An existing heap always gets its header and zone chain checked; the full
+// block walk only runs when the last process did not close it cleanly
+static int pheap_reopen(t_pheap_header *header, int fd, size_t size,
+                        size_t file_size)
+{
+    if (mmap(header, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+             fd, 0) == MAP_FAILED)
+        return -1;
+    if (!check_header(header, file_size)
+        || !check_zones(header, header->dirty))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    header->dirty = 1;
+    header_seal(header);
+    return 0;
+}
+
+t_pheap *pheap_open(const char *path, void *base, size_t span)
+{
+    t_pheap_header saved;
+    t_pheap *heap;
+    struct stat st;
+    size_t page = getpagesize();
+    void *reserved;
+    int fd;
+    int err;
+
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return NULL;
+    // One process at a time: the lock goes away with the descriptor
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0 || fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    // A new heap takes the caller's placement, an existing one its own
+    ft_bzero(&saved, sizeof(saved));
+    if (st.st_size != 0)
+    {
+        if (pread(fd, &saved, sizeof(saved), 0) != (ssize_t)sizeof(saved)
+            || ft_memcmp(saved.magic, PHEAP_MAGIC, sizeof(saved.magic)) != 0
+            || saved.size > saved.span || saved.size > (size_t)st.st_size)
+        {
+            close(fd);
+            errno = EINVAL;
+            return NULL;
+        }
+        base = (void *)(uintptr_t)saved.base;
+        span = saved.span;
+    }
+    else
+    {
+        base = base ? base : (void *)PHEAP_BASE;
+        span = ((span ? span : PHEAP_SPAN) + page - 1) & ~(page - 1);
+    }
+    if (((uintptr_t)base & (page - 1)) != 0 || span < page)
+    {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    // Reserve the whole span so that growing the heap never lands on
+    // someone else's mapping
+    reserved = mmap(base, span, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE
+                    | MAP_FIXED_NOREPLACE, -1, 0);
+    if (reserved != MAP_FAILED && reserved != base)
+    {
+        // Kernels before 4.17 take the address as a mere hint
+        munmap(reserved, span);
+        reserved = MAP_FAILED;
+        errno = EEXIST;
+    }
+    if (reserved == MAP_FAILED)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    heap = internal_malloc(sizeof(t_pheap));
+    if (!heap || (st.st_size == 0 ? pheap_create(base, fd, span)
+                  : pheap_reopen(base, fd, saved.size, st.st_size)) != 0)
+    {
+        err = heap ? errno : ENOMEM;
+        munmap(base, span);
+        internal_free(heap);
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+
+    heap->header = base;
+    heap->fd = fd;
+    return heap;
+}
+
+void *pheap_alloc(t_pheap *heap, size_t size)
+{
+    t_pheap_header *header;
+    t_zone *zone;
+    void *ptr;
+
+    if (!heap || size == 0 || size > heap->header->span)
+        return NULL;
+    header = heap->header;
+    size = ALIGN(size);
+
+    zone = PHEAP_FIRST(header);
+    while (zone < PHEAP_END(header))
+    {
+        if (zone->free_size >= size && (ptr = allocate_in_zone(zone, size)))
+            return ptr;
+        zone = next_zone(zone);
+    }
+    zone = pheap_grow(heap, size);
+    if (!zone)
+        return NULL;
+    return allocate_in_zone(zone, size);
+}
+
+void pheap_free(t_pheap *heap, void *ptr)
+{
+    t_zone *zone;
+    t_block *block;
+    size_t size;
+
+    if (!heap || !ptr || !(zone = pheap_find_zone(heap, ptr)))
+        return;
+    block = (t_block *)((char *)ptr - BLOCK_HEADER_SIZE);
+    if (IS_FREE(block->size))
+        return;
+
+    size = GET_SIZE(block->size);
+    block->size = SET_FREE(size);
+    zone->free_blocks++;
+    zone->free_size += size;
+    coalesce_blocks(zone, block);
+
+    // Never leave the root pointing at freed memory
+    if (heap->header->root == (uint64_t)(uintptr_t)ptr)
+    {
+        heap->header->root = 0;
+        header_seal(heap->header);
+    }
+}
+
+void *pheap_root(t_pheap *heap)
+{
+    if (!heap)
+        return NULL;
+    return (void *)(uintptr_t)heap->header->root;
+}
+
+void pheap_set_root(t_pheap *heap, void *ptr)
+{
+    if (!heap || (ptr && !pheap_find_zone(heap, ptr)))
+        return;
+    heap->header->root = (uint64_t)(uintptr_t)ptr;
+    header_seal(heap->header);
+}
+
+int pheap_check(t_pheap *heap)
+{
+    struct stat st;
+
+    if (!heap || fstat(heap->fd, &st) != 0)
+        return -1;
+    if (!check_header(heap->header, st.st_size)
+        || !check_zones(heap->header, 1))
+        return -1;
+    return 0;
+}
+
+int pheap_sync(t_pheap *heap)
+{
+    if (!heap)
+        return -1;
+    return msync(heap->header, heap->header->size, MS_SYNC);
+}
+
+int pheap_close(t_pheap *heap)
+{
+    t_pheap_header *header;
+    int ret;
+
+    if (!heap)
+        return -1;
+    header = heap->header;
+
+    // Flush the data first, then mark the heap clean
+    ret = msync(header, header->size, MS_SYNC);
+    if (ret == 0)
+    {
+        header->dirty = 0;
+        header_seal(header);
+        ret = msync(header, header->page_size, MS_SYNC);
+    }
+    munmap(header, header->span);
+    close(heap->fd);
+    internal_free(heap);
+    return ret;
+}
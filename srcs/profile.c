@@ -0,0 +1,224 @@
+#include "malloc.h"
+#include <fcntl.h>
+#include <stdlib.h>
+
+#ifndef MADV_POPULATE_WRITE
+# define MADV_POPULATE_WRITE    23
+#endif
+
+#define WARM_RANGES     8
+
+typedef struct s_warm_range {
+    char    *start;
+    size_t  size;
+} t_warm_range;
+
+// Zones mapped by the last warm-up, to be faulted in
+static t_warm_range g_warm_ranges[WARM_RANGES];
+static size_t       g_warm_count = 0;
+
+static void warm_range_add(void *start, size_t size)
+{
+    t_warm_range *last;
+
+    last = g_warm_count ? &g_warm_ranges[g_warm_count - 1] : NULL;
+    if (last && last->start + last->size == (char *)start)
+        last->size += size;
+    else if (g_warm_count < WARM_RANGES)
+    {
+        g_warm_ranges[g_warm_count].start = start;
+        g_warm_ranges[g_warm_count].size = size;
+        g_warm_count++;
+    }
+}
+
+// Fault the warm zones in with one madvise per range instead of one page
+// fault per page. This runs on the calling thread: a helper thread would
+// run glibc's thread setup and teardown, which call malloc and free, next
+// to the main thread, and the allocator has no locks.
+static void prefault_ranges(void)
+{
+    size_t i;
+
+    for (i = 0; i < g_warm_count; i++)
+        madvise(g_warm_ranges[i].start, g_warm_ranges[i].size,
+                MADV_POPULATE_WRITE);
+}
+
+// Zones needed to hold the profiled live blocks of a tier
+static size_t zones_for_classes(const t_heap_profile *profile, int type)
+{
+    size_t zone_size;
+    size_t bytes = 0;
+    size_t usable;
+    size_t i;
+
+    for (i = 0; i < QUICK_BINS; i++)
+        if (get_zone_type((i + 1) * ALIGNMENT) == type)
+            bytes += profile->classes[i] * ((i + 1) * ALIGNMENT + BLOCK_HEADER_SIZE);
+
+    zone_size = get_zone_size(type, 0);
+    usable = zone_size - ZONE_HEADER_SIZE - BLOCK_HEADER_SIZE;
+    return (bytes + usable - 1) / usable;
+}
+
+// Map `count` zones of a tier: one mapping carved into zones, or zones
+// from the reserved range when there is one
+static size_t warm_tier(int type, size_t count)
+{
+    t_zone **list;
+    t_zone *zone;
+    char *bulk;
+    size_t zone_size;
+    size_t i;
+
+    list = get_zone_list(type);
+    zone_size = get_zone_size(type, 0);
+    if (g_malloc_data.reserve.base)
+    {
+        for (i = 0; i < count; i++)
+        {
+            zone = create_zone(zone_size, type);
+            if (!zone)
+                break;
+            add_zone(list, zone);
+            warm_range_add(zone, zone_size);
+        }
+        return i;
+    }
+
+    if (!budget_admit(count * zone_size))
+        return 0;
+    bulk = mmap(NULL, count * zone_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bulk == MAP_FAILED)
+        return 0;
+    g_malloc_data.stats.syscalls++;
+
+    // Each zone is still unmapped on its own by destroy_zone
+    for (i = 0; i < count; i++)
+    {
+        zone = (t_zone *)(bulk + i * zone_size);
+        adopt_zone(zone, zone_size, type);
+        add_zone(list, zone);
+    }
+    warm_range_add(bulk, count * zone_size);
+    return count;
+}
+
+size_t malloc_warm(const t_heap_profile *profile, int prefault)
+{
+    size_t warmed = 0;
+    size_t target;
+    size_t needed;
+    int type;
+
+    g_warm_count = 0;
+    for (type = TINY_ZONE; type <= SMALL_ZONE; type++)
+    {
+        target = profile->zones[type];
+        needed = zones_for_classes(profile, type);
+        if (needed > target)
+            target = needed;
+        if (target > PROFILE_MAX_ZONES)
+            target = PROFILE_MAX_ZONES;
+        if (target > g_malloc_data.stats.zones[type])
+            warmed += warm_tier(type, target - g_malloc_data.stats.zones[type]);
+    }
+
+    if (prefault)
+        prefault_ranges();
+    return warmed;
+}
+
+static void count_live_blocks(t_zone *zone, uint64_t *classes)
+{
+    t_block *block;
+    char *zone_end;
+    size_t size;
+
+    while (zone)
+    {
+        zone_end = (char *)zone + zone->size;
+        block = (t_block *)((char *)zone + ZONE_HEADER_SIZE);
+        while ((char *)block < zone_end)
+        {
+            size = GET_SIZE(block->size);
+            if (size == 0 || (char *)block + BLOCK_HEADER_SIZE + size > zone_end)
+                break;
+            if (!IS_FREE(block->size) && !IS_QUICK(block->size))
+                classes[(size < SMALL_MAX ? size : SMALL_MAX) / ALIGNMENT - 1]++;
+            block = (t_block *)((char *)block + BLOCK_HEADER_SIZE + size);
+        }
+        zone = zone->next;
+    }
+}
+
+int malloc_profile_save(const char *path)
+{
+    t_heap_profile profile;
+    int type;
+    int fd;
+
+    ft_bzero(&profile, sizeof(profile));
+    ft_memcpy(profile.magic, PROFILE_MAGIC, sizeof(profile.magic));
+    profile.version = PROFILE_VERSION;
+    profile.page_size = (uint32_t)getpagesize();
+    for (type = 0; type < ZONE_TYPES; type++)
+        profile.zones[type] = g_malloc_data.stats.peak_zones[type];
+    count_live_blocks(g_malloc_data.tiny_zones, profile.classes);
+    count_live_blocks(g_malloc_data.small_zones, profile.classes);
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+    if (write(fd, &profile, sizeof(profile)) != sizeof(profile))
+    {
+        close(fd);
+        return -1;
+    }
+    return close(fd);
+}
+
+int malloc_profile_load(const char *path, t_heap_profile *profile)
+{
+    ssize_t len;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    len = read(fd, profile, sizeof(t_heap_profile));
+    close(fd);
+    if (len != sizeof(t_heap_profile)
+        || ft_memcmp(profile->magic, PROFILE_MAGIC, sizeof(profile->magic)) != 0
+        || profile->version != PROFILE_VERSION
+        || profile->page_size != (uint32_t)getpagesize())
+        return -1;
+    return 0;
+}
+
+// Runs after the reserve and budget constructors (priority 101)
+__attribute__((constructor))
+static void profile_init(void)
+{
+    t_heap_profile profile;
+    const char *path;
+    const char *prefault;
+
+    path = getenv("FT_MALLOC_PROFILE");
+    if (!path || !*path || malloc_profile_load(path, &profile) != 0)
+        return;
+    prefault = getenv("FT_MALLOC_PREFAULT");
+    malloc_warm(&profile, prefault && *prefault && *prefault != '0');
+}
+
+__attribute__((destructor))
+static void profile_fini(void)
+{
+    const char *path;
+
+    path = getenv("FT_MALLOC_PROFILE");
+    if (path && *path)
+        malloc_profile_save(path);
+}
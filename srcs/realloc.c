@@ -1,6 +1,6 @@
 #include "malloc.h"
 
-void *realloc(void *ptr, size_t size)
+void *internal_realloc(void *ptr, size_t size)
 {
     void *new_ptr;
     t_zone *zone;
@@ -8,11 +8,11 @@ void *realloc(void *ptr, size_t size)
     size_t old_size;
     
     if (!ptr)
-        return malloc(size);
+        return internal_malloc(size);
     
     if (size == 0)
     {
-        free(ptr);
+        internal_free(ptr);
         return NULL;
     }
     
@@ -27,8 +27,12 @@ void *realloc(void *ptr, size_t size)
     if (ALIGN(size) <= old_size)
         return ptr;
     
+    // Region blocks can only go away with their region, so they cannot move
+    if (zone->flags & ZONE_REGION)
+        return NULL;
+    
     // Allocate new block
-    new_ptr = malloc(size);
+    new_ptr = internal_malloc(size);
     if (!new_ptr)
         return NULL;
     
@@ -36,7 +40,23 @@ void *realloc(void *ptr, size_t size)
     ft_memcpy(new_ptr, ptr, old_size < size ? old_size : size);
     
     // Free old block
-    free(ptr);
+    internal_free(ptr);
     
     return new_ptr;
-}
\ No newline at end of file
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    void *new_ptr;
+    uint64_t start;
+    
+    start = g_malloc_data.latency ? latency_begin() : 0;
+    new_ptr = internal_realloc(ptr, size);
+    if (start)
+        latency_end(LAT_REALLOC, get_zone_type(ALIGN(size)), start);
+    if (g_malloc_data.tracing)
+        trace_record(TRACE_REALLOC, new_ptr, ptr, size);
+    if (g_malloc_data.shm)
+        shm_stats_tick(LAT_REALLOC);
+    return new_ptr;
+}
@@ -0,0 +1,186 @@
+#include "malloc.h"
+
+static t_zone *find_empty_zone(t_zone *zone)
+{
+    while (zone && !zone_is_empty(zone))
+        zone = zone->next;
+    return zone;
+}
+
+// Prefer the empty SMALL zone that free() keeps around over a new mmap
+static t_zone *region_take_zone(void)
+{
+    t_zone *zone;
+
+    zone = find_empty_zone(g_malloc_data.small_zones);
+    if (zone)
+    {
+        remove_zone(&g_malloc_data.small_zones, zone);
+        init_zone(zone, zone->size, SMALL_ZONE);
+    }
+    else
+        zone = create_zone(SMALL_ZONE_SIZE, SMALL_ZONE);
+
+    if (zone)
+        zone->flags |= ZONE_REGION;
+    return zone;
+}
+
+// Hand a SMALL zone back to the zone pool if that tier has no spare empty
+// zone yet, otherwise unmap it
+static void region_return_zone(t_zone *zone)
+{
+    if (zone->type == SMALL_ZONE && !find_empty_zone(g_malloc_data.small_zones))
+    {
+        init_zone(zone, zone->size, SMALL_ZONE);
+        add_zone(&g_malloc_data.small_zones, zone);
+        return;
+    }
+    destroy_zone(zone);
+}
+
+static void region_release_zones(t_region *region)
+{
+    t_zone *zone;
+    t_zone *next;
+
+    zone = region->zones;
+    while (zone)
+    {
+        next = zone->next;
+        region_return_zone(zone);
+        zone = next;
+    }
+
+    region->zones = NULL;
+    region->current = NULL;
+    region->tail = NULL;
+    region->last = NULL;
+}
+
+// Requests that do not fit a SMALL zone get a dedicated zone, leaving the
+// current bump zone untouched
+static void *region_alloc_large(t_region *region, size_t size)
+{
+    t_zone *zone;
+
+    zone = create_zone(get_zone_size(LARGE_ZONE, size), LARGE_ZONE);
+    if (!zone)
+        return NULL;
+
+    zone->flags |= ZONE_REGION;
+    add_zone(&region->zones, zone);
+    return allocate_in_zone(zone, size);
+}
+
+t_region *region_create(void)
+{
+    t_region *region;
+
+    region = internal_malloc(sizeof(t_region));
+    if (!region)
+        return NULL;
+
+    ft_bzero(region, sizeof(t_region));
+    region->next = g_malloc_data.regions;
+    if (region->next)
+        region->next->prev = region;
+    g_malloc_data.regions = region;
+    return region;
+}
+
+void *region_alloc(t_region *region, size_t size)
+{
+    t_zone *zone;
+    t_block *block;
+    size_t tail_size;
+
+    if (!region || size == 0)
+        return NULL;
+
+    size = ALIGN(size);
+    if (size > SMALL_ZONE_SIZE - ZONE_HEADER_SIZE - BLOCK_HEADER_SIZE)
+        return region_alloc_large(region, size);
+
+    if (!region->tail || GET_SIZE(region->tail->size) < size)
+    {
+        zone = region_take_zone();
+        if (!zone)
+            return NULL;
+        add_zone(&region->zones, zone);
+        region->current = zone;
+        region->tail = (t_block *)((char *)zone + ZONE_HEADER_SIZE);
+    }
+
+    // Bump: carve the block off the front of the free tail
+    zone = region->current;
+    block = region->tail;
+    tail_size = GET_SIZE(block->size);
+    if (tail_size > size + BLOCK_HEADER_SIZE + ALIGNMENT)
+    {
+        split_block(block, size, (char *)zone + zone->size);
+        region->tail = (t_block *)((char *)block + BLOCK_HEADER_SIZE + size);
+    }
+    else
+    {
+        size = tail_size;
+        block->size = size;
+        zone->free_blocks--;
+        region->tail = NULL;
+    }
+
+    zone->free_size -= size;
+    region->last = block;
+    return (char *)block + BLOCK_HEADER_SIZE;
+}
+
+int region_free_last(t_region *region, void *ptr)
+{
+    t_zone *zone;
+    t_block *block;
+    size_t size;
+
+    if (!region || !region->last
+        || ptr != (char *)region->last + BLOCK_HEADER_SIZE)
+        return -1;
+
+    // The last block always sits right before the tail, so merging it back
+    // simply moves the bump pointer down
+    zone = region->current;
+    block = region->last;
+    size = GET_SIZE(block->size);
+    block->size = SET_FREE(size);
+    zone->free_blocks++;
+    zone->free_size += size;
+    coalesce_blocks(zone, block);
+    region->tail = block;
+
+    // Allow popping allocations in LIFO order within the current zone
+    if ((char *)block > (char *)zone + ZONE_HEADER_SIZE)
+        region->last = (t_block *)((char *)block - BLOCK_HEADER_SIZE
+                                   - block->prev_size);
+    else
+        region->last = NULL;
+    return 0;
+}
+
+void region_reset(t_region *region)
+{
+    if (region)
+        region_release_zones(region);
+}
+
+void region_destroy(t_region *region)
+{
+    if (!region)
+        return;
+
+    region_release_zones(region);
+    if (region->prev)
+        region->prev->next = region->next;
+    else
+        g_malloc_data.regions = region->next;
+    if (region->next)
+        region->next->prev = region->prev;
+    internal_free(region);
+}
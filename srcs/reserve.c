@@ -0,0 +1,138 @@
+#include "malloc.h"
+#include <stdlib.h>
+
+// Marks the granules holding the owner table itself
+#define RESERVE_META    UINT32_MAX
+
+static size_t granules_for(t_reserve *r, size_t size)
+{
+    return (size + r->granule - 1) / r->granule;
+}
+
+// Committed memory only ever grows as a prefix of the reservation, so the
+// whole heap stays one read-write VMA followed by one PROT_NONE VMA.
+// Released zones are given back with MADV_DONTNEED and stay read-write.
+static int reserve_commit(t_reserve *r, size_t end)
+{
+    if (end <= r->committed)
+        return 0;
+    if (mprotect(r->base + r->committed, end - r->committed,
+                 PROT_READ | PROT_WRITE) != 0)
+        return -1;
+    g_malloc_data.stats.syscalls++;
+    r->committed = end;
+    return 0;
+}
+
+int malloc_reserve(size_t size)
+{
+    t_reserve *r = &g_malloc_data.reserve;
+    size_t meta;
+    size_t i;
+    void *base;
+
+    if (r->base || size == 0)
+        return -1;
+
+    r->granule = TINY_ZONE_SIZE;
+    size = granules_for(r, size) * r->granule;
+    base = mmap(NULL, size, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED)
+        return -1;
+
+    r->base = base;
+    r->size = size;
+    r->count = size / r->granule;
+    r->committed = 0;
+
+    // The owner table lives in the first granules of the reservation
+    meta = granules_for(r, r->count * sizeof(uint32_t));
+    if (meta >= r->count || reserve_commit(r, meta * r->granule) != 0)
+    {
+        munmap(base, size);
+        r->base = NULL;
+        return -1;
+    }
+    r->owner = (uint32_t *)r->base;
+    for (i = 0; i < meta; i++)
+        r->owner[i] = RESERVE_META;
+    r->hint = meta;
+    return 0;
+}
+
+t_zone *reserve_zone(size_t size)
+{
+    t_reserve *r = &g_malloc_data.reserve;
+    size_t needed;
+    size_t start;
+    size_t run;
+    size_t i;
+
+    if (!r->base)
+        return NULL;
+
+    // First fit over the owner table, starting at the first free granule
+    needed = granules_for(r, size);
+    run = 0;
+    for (i = r->hint; i < r->count && run < needed; i++)
+        run = r->owner[i] ? 0 : run + 1;
+    if (run < needed)
+        return NULL;
+    start = i - needed;
+
+    if (reserve_commit(r, (start + needed) * r->granule) != 0)
+        return NULL;
+
+    for (i = start; i < start + needed; i++)
+        r->owner[i] = (uint32_t)start + 1;
+    if (start == r->hint)
+        r->hint = start + needed;
+    return (t_zone *)(r->base + start * r->granule);
+}
+
+void reserve_release(t_zone *zone)
+{
+    t_reserve *r = &g_malloc_data.reserve;
+    size_t start;
+    size_t count;
+    size_t i;
+
+    start = ((char *)zone - r->base) / r->granule;
+    count = granules_for(r, zone->size);
+
+    madvise(zone, count * r->granule, MADV_DONTNEED);
+    g_malloc_data.stats.syscalls++;
+    for (i = start; i < start + count; i++)
+        r->owner[i] = 0;
+    if (start < r->hint)
+        r->hint = start;
+}
+
+t_zone *reserve_find_zone(void *ptr)
+{
+    t_reserve *r = &g_malloc_data.reserve;
+    t_zone *zone;
+    uint32_t owner;
+
+    owner = r->owner[((char *)ptr - r->base) / r->granule];
+    if (owner == 0 || owner == RESERVE_META)
+        return NULL;
+
+    // The last granule of a zone may extend past zone->size
+    zone = (t_zone *)(r->base + (size_t)(owner - 1) * r->granule);
+    if ((char *)ptr >= (char *)zone + zone->size)
+        return NULL;
+    return zone;
+}
+
+// Priority 101: must be set up before the profile warm-up maps zones
+__attribute__((constructor(101)))
+static void reserve_init(void)
+{
+    size_t size;
+
+    size = ft_parse_size(getenv("FT_MALLOC_RESERVE"));
+    if (size)
+        malloc_reserve(size);
+}
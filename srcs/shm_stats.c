@@ -0,0 +1,166 @@
+#include "malloc.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#define SHM_SET(field, value)   __atomic_store_n(&(field), (value), __ATOMIC_RELAXED)
+
+static uint32_t g_shm_calls = 0;
+static int      g_shm_atfork = 0;
+
+// "/ft_malloc.<pid>", built without snprintf (which may call malloc)
+static void shm_stats_name(char *name, pid_t pid)
+{
+    char digits[16];
+    size_t len = 0;
+    size_t prefix;
+
+    prefix = sizeof(SHM_STATS_PREFIX) - 1;
+    ft_memcpy(name, SHM_STATS_PREFIX, prefix);
+    do
+    {
+        digits[len++] = '0' + pid % 10;
+        pid /= 10;
+    } while (pid);
+    while (len)
+        name[prefix++] = digits[--len];
+    name[prefix] = '\0';
+}
+
+// Add a zone list to the totals of each zone's own tier
+static void sum_zones(t_shm_tier *tiers, t_zone *zone)
+{
+    t_shm_tier *tier;
+
+    // Zone headers only: the free counters are kept up to date by every
+    // allocation, so no block walk is needed
+    while (zone)
+    {
+        tier = &tiers[zone->type];
+        tier->mapped += zone->size;
+        tier->used += zone_capacity(zone) - zone->free_size;
+        tier->free += zone->free_size;
+        tier->free_blocks += zone->free_blocks;
+        tier->zones++;
+        zone = zone->next;
+    }
+}
+
+void shm_stats_refresh(void)
+{
+    t_shm_stats *page = g_malloc_data.shm;
+    t_shm_tier tiers[ZONE_TYPES];
+    t_region *region;
+    int type;
+
+    if (!page)
+        return;
+    ft_bzero(tiers, sizeof(tiers));
+    sum_zones(tiers, g_malloc_data.tiny_zones);
+    sum_zones(tiers, g_malloc_data.small_zones);
+    sum_zones(tiers, g_malloc_data.medium_zones);
+    sum_zones(tiers, g_malloc_data.large_zones);
+    // Region zones are mapped like any other and count toward their tier
+    for (region = g_malloc_data.regions; region; region = region->next)
+        sum_zones(tiers, region->zones);
+    for (type = 0; type < ZONE_TYPES; type++)
+    {
+        SHM_SET(page->tiers[type].mapped, tiers[type].mapped);
+        SHM_SET(page->tiers[type].used, tiers[type].used);
+        SHM_SET(page->tiers[type].free, tiers[type].free);
+        SHM_SET(page->tiers[type].zones, tiers[type].zones);
+        SHM_SET(page->tiers[type].free_blocks, tiers[type].free_blocks);
+    }
+    SHM_SET(page->syscalls, g_malloc_data.stats.syscalls);
+    SHM_SET(page->quick_hits, g_malloc_data.quick.hits);
+    SHM_SET(page->quick_misses, g_malloc_data.quick.misses);
+    SHM_SET(page->reclaims, g_malloc_data.stats.reclaims);
+    SHM_SET(page->peak_mapped, g_malloc_data.stats.peak_mapped);
+    __atomic_add_fetch(&page->seq, 1, __ATOMIC_RELEASE);
+}
+
+void shm_stats_tick(int op)
+{
+    t_shm_stats *page = g_malloc_data.shm;
+
+    SHM_SET(page->calls[op], page->calls[op] + 1);
+    if (++g_shm_calls % SHM_STATS_EVERY == 0)
+        shm_stats_refresh();
+}
+
+// A forked child would keep writing into its parent's page: drop it
+static void shm_stats_child(void)
+{
+    if (g_malloc_data.shm)
+    {
+        munmap(g_malloc_data.shm, sizeof(t_shm_stats));
+        g_malloc_data.shm = NULL;
+    }
+}
+
+int malloc_stats_publish(int enable)
+{
+    t_shm_stats *page;
+    char name[32];
+    int fd;
+
+    shm_stats_name(name, getpid());
+    if (!enable)
+    {
+        if (g_malloc_data.shm)
+        {
+            munmap(g_malloc_data.shm, sizeof(t_shm_stats));
+            g_malloc_data.shm = NULL;
+            shm_unlink(name);
+        }
+        return 0;
+    }
+    if (g_malloc_data.shm)
+        return 0;
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+    if (ftruncate(fd, sizeof(t_shm_stats)) != 0)
+    {
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    page = mmap(NULL, sizeof(t_shm_stats), PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return -1;
+    }
+
+    // The magic goes in last so readers never see a half-initialized page
+    page->version = SHM_STATS_VERSION;
+    page->pid = (uint32_t)getpid();
+    g_malloc_data.shm = page;
+    if (!g_shm_atfork)
+        g_shm_atfork = pthread_atfork(NULL, NULL, shm_stats_child) == 0;
+    shm_stats_refresh();
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    ft_memcpy(page->magic, SHM_STATS_MAGIC, sizeof(page->magic));
+    return 0;
+}
+
+__attribute__((constructor))
+static void shm_stats_init(void)
+{
+    const char *value;
+
+    value = getenv("FT_MALLOC_SHM");
+    if (value && *value && *value != '0')
+        malloc_stats_publish(1);
+}
+
+// The page is named after the pid, so it must not outlive the process
+__attribute__((destructor))
+static void shm_stats_fini(void)
+{
+    malloc_stats_publish(0);
+}
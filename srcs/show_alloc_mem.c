@@ -1,11 +1,17 @@
 #include "malloc.h"
 
-static void print_zone_type(int type)
+static void print_zone_type(t_zone *zone)
 {
-    if (type == TINY_ZONE)
+    int type = zone->type;
+    
+    if (zone->flags & ZONE_REGION)
+        ft_putstr("REGION : ");
+    else if (type == TINY_ZONE)
         ft_putstr("TINY : ");
     else if (type == SMALL_ZONE)
         ft_putstr("SMALL : ");
+    else if (type == MEDIUM_ZONE)
+        ft_putstr("MEDIUM : ");
     else
         ft_putstr("LARGE : ");
 }
@@ -18,12 +24,12 @@ static size_t print_zone(t_zone *zone)
     void *ptr;
     size_t block_size;
     
-    print_zone_type(zone->type);
+    print_zone_type(zone);
     print_hex((size_t)zone);
     ft_putstr("\n");
     
     zone_end = (char *)zone + zone->size;
-    block = (t_block *)((char *)zone + ZONE_HEADER_SIZE);
+    block = zone_first_block(zone);
     
     while ((char *)block < zone_end)
     {
@@ -37,7 +43,7 @@ static size_t print_zone(t_zone *zone)
         if ((char *)block + BLOCK_HEADER_SIZE + block_size > zone_end)
             break;
             
-        if (!IS_FREE(block->size))
+        if (!IS_FREE(block->size) && !IS_QUICK(block->size))
         {
             ptr = (char *)block + BLOCK_HEADER_SIZE;
             print_hex((size_t)ptr);
@@ -58,6 +64,7 @@ static size_t print_zone(t_zone *zone)
 void show_alloc_mem(void)
 {
     t_zone *zone;
+    t_region *region;
     size_t total = 0;
     
     // Print tiny zones
@@ -76,6 +83,14 @@ void show_alloc_mem(void)
         zone = zone->next;
     }
     
+    // Print medium zones
+    zone = g_malloc_data.medium_zones;
+    while (zone)
+    {
+        total += print_zone(zone);
+        zone = zone->next;
+    }
+    
     // Print large zones
     zone = g_malloc_data.large_zones;
     while (zone)
@@ -84,6 +99,19 @@ void show_alloc_mem(void)
         zone = zone->next;
     }
     
+    // Print region zones
+    region = g_malloc_data.regions;
+    while (region)
+    {
+        zone = region->zones;
+        while (zone)
+        {
+            total += print_zone(zone);
+            zone = zone->next;
+        }
+        region = region->next;
+    }
+    
     ft_putstr("Total : ");
     ft_putnbr(total);
     ft_putstr(" bytes\n");
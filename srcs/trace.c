@@ -0,0 +1,265 @@
+#include "malloc.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/syscall.h>
+
+// One ring per thread: the owning thread is the only producer, the
+// flusher thread (or the owner itself when the ring is full) consumes.
+typedef struct s_trace_ring {
+    struct s_trace_ring *next;      // Registry link, never unlinked
+    int                 in_use;     // Claimed by a live thread
+    int                 draining;   // Consumer lock
+    uint32_t            tid;
+    size_t              head;       // Next slot to write (owner)
+    size_t              tail;       // Next slot to flush (consumer)
+    t_trace_event       events[TRACE_RING_EVENTS];
+} t_trace_ring;
+
+static int              g_trace_fd = -1;
+static int              g_trace_header_fd = -1;    // Not O_APPEND, for pwrite
+static int              g_trace_failed = 0;
+static uint64_t         g_trace_dropped = 0;
+static int              g_trace_stop = 0;
+static t_trace_ring     *g_trace_rings = NULL;
+static pthread_t        g_trace_thread;
+static pthread_key_t    g_trace_key;
+
+static __thread t_trace_ring    *t_ring = NULL;
+static __thread int             t_in_trace = 0;
+
+static uint64_t trace_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Write a chunk, retrying short writes. Returns the bytes written, which
+// is less than `size` only on error.
+static size_t trace_write(const void *data, size_t size)
+{
+    size_t done = 0;
+    ssize_t written;
+
+    while (done < size)
+    {
+        written = write(g_trace_fd, (const char *)data + done, size - done);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            break;
+        done += (size_t)written;
+    }
+    return done;
+}
+
+static void trace_drain(t_trace_ring *ring)
+{
+    size_t head;
+    size_t tail;
+    size_t start;
+    size_t count;
+    size_t written;
+
+    if (__atomic_exchange_n(&ring->draining, 1, __ATOMIC_ACQUIRE))
+        return;
+
+    head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    tail = ring->tail;
+
+    // Write [tail, head) in at most two chunks (the ring may wrap)
+    while (tail < head && !__atomic_load_n(&g_trace_failed, __ATOMIC_ACQUIRE))
+    {
+        start = tail % TRACE_RING_EVENTS;
+        count = head - tail;
+        if (count > TRACE_RING_EVENTS - start)
+            count = TRACE_RING_EVENTS - start;
+        written = trace_write(&ring->events[start],
+                              count * sizeof(t_trace_event));
+        tail += written / sizeof(t_trace_event);
+        // Anything appended after a failed write would be misaligned: stop
+        // writing and only count what is lost from now on
+        if (written < count * sizeof(t_trace_event))
+            __atomic_store_n(&g_trace_failed, 1, __ATOMIC_RELEASE);
+    }
+    if (tail < head)
+        __atomic_fetch_add(&g_trace_dropped, head - tail, __ATOMIC_RELAXED);
+
+    // The ring is emptied either way, so that producers never wait on it
+    __atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->draining, 0, __ATOMIC_RELEASE);
+}
+
+static void trace_drain_all(void)
+{
+    t_trace_ring *ring;
+
+    ring = __atomic_load_n(&g_trace_rings, __ATOMIC_ACQUIRE);
+    while (ring)
+    {
+        trace_drain(ring);
+        ring = ring->next;
+    }
+}
+
+static void *trace_flusher(void *arg)
+{
+    struct timespec delay;
+
+    (void)arg;
+    delay.tv_sec = 0;
+    delay.tv_nsec = TRACE_FLUSH_NS;
+    while (!__atomic_load_n(&g_trace_stop, __ATOMIC_ACQUIRE))
+    {
+        nanosleep(&delay, NULL);
+        trace_drain_all();
+    }
+    return NULL;
+}
+
+static void trace_release_ring(void *arg)
+{
+    t_trace_ring *ring = arg;
+
+    trace_drain(ring);
+    __atomic_store_n(&ring->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static t_trace_ring *trace_claim_ring(void)
+{
+    t_trace_ring *ring;
+    int expected;
+
+    // Reuse a ring left behind by an exited thread
+    ring = __atomic_load_n(&g_trace_rings, __ATOMIC_ACQUIRE);
+    while (ring)
+    {
+        expected = 0;
+        if (__atomic_compare_exchange_n(&ring->in_use, &expected, 1, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            break;
+        ring = ring->next;
+    }
+
+    if (!ring)
+    {
+        ring = mmap(NULL, sizeof(t_trace_ring), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ring == MAP_FAILED)
+            return NULL;
+        ring->in_use = 1;
+        ring->next = __atomic_load_n(&g_trace_rings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&g_trace_rings, &ring->next, ring,
+                                            0, __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED))
+            ;
+    }
+
+    ring->tid = (uint32_t)syscall(SYS_gettid);
+    pthread_setspecific(g_trace_key, ring);
+    return ring;
+}
+
+void trace_record(uint32_t op, void *ptr, void *arg, size_t size)
+{
+    t_trace_event *event;
+    size_t head;
+
+    if (t_in_trace)
+        return;
+    t_in_trace = 1;
+
+    if (!t_ring)
+        t_ring = trace_claim_ring();
+    if (t_ring)
+    {
+        head = t_ring->head;
+        // Ring full: flush it ourselves rather than dropping events
+        while (head - __atomic_load_n(&t_ring->tail, __ATOMIC_ACQUIRE)
+               >= TRACE_RING_EVENTS)
+            trace_drain(t_ring);
+
+        event = &t_ring->events[head % TRACE_RING_EVENTS];
+        event->timestamp = trace_now();
+        event->ptr = (uint64_t)(uintptr_t)ptr;
+        event->arg = (uint64_t)(uintptr_t)arg;
+        event->size = size;
+        event->tid = t_ring->tid;
+        event->op = op;
+        __atomic_store_n(&t_ring->head, head + 1, __ATOMIC_RELEASE);
+    }
+
+    t_in_trace = 0;
+}
+
+__attribute__((constructor))
+static void trace_init(void)
+{
+    t_trace_header header;
+    const char *path;
+
+    path = getenv("FT_MALLOC_TRACE");
+    if (!path || !*path)
+        return;
+
+    g_trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (g_trace_fd < 0)
+        return;
+
+    ft_bzero(&header, sizeof(header));
+    ft_memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.event_size = sizeof(t_trace_event);
+    g_trace_header_fd = open(path, O_WRONLY);
+    if (g_trace_header_fd < 0
+        || trace_write(&header, sizeof(header)) != sizeof(header)
+        || pthread_key_create(&g_trace_key, trace_release_ring) != 0)
+    {
+        if (g_trace_header_fd >= 0)
+            close(g_trace_header_fd);
+        close(g_trace_fd);
+        g_trace_fd = -1;
+        return;
+    }
+
+    // Keep pthread_create's own allocations (stack, TLS) out of the trace;
+    // t_in_trace is per thread, so this does not cover the flusher itself
+    t_in_trace = 1;
+    if (pthread_create(&g_trace_thread, NULL, trace_flusher, NULL) != 0)
+        g_trace_stop = 1;
+    t_in_trace = 0;
+
+    g_malloc_data.tracing = 1;
+}
+
+__attribute__((destructor))
+static void trace_fini(void)
+{
+    uint64_t dropped;
+
+    if (g_trace_fd < 0)
+        return;
+
+    g_malloc_data.tracing = 0;
+    if (!g_trace_stop)
+    {
+        __atomic_store_n(&g_trace_stop, 1, __ATOMIC_RELEASE);
+        pthread_join(g_trace_thread, NULL);
+    }
+    trace_drain_all();
+    close(g_trace_fd);
+    g_trace_fd = -1;
+
+    // Rewriting the header in place needs no new space, so this works even
+    // when the events failed for lack of it
+    dropped = __atomic_load_n(&g_trace_dropped, __ATOMIC_RELAXED);
+    if (dropped)
+        pwrite(g_trace_header_fd, &dropped, sizeof(dropped),
+               offsetof(t_trace_header, dropped));
+    close(g_trace_header_fd);
+    g_trace_header_fd = -1;
+}
@@ -10,6 +10,21 @@ void *ft_memcpy(void *dst, const void *src, size_t n)
     return dst;
 }
 
+int ft_memcmp(const void *s1, const void *s2, size_t n)
+{
+    const unsigned char *a = s1;
+    const unsigned char *b = s2;
+    
+    while (n--)
+    {
+        if (*a != *b)
+            return *a - *b;
+        a++;
+        b++;
+    }
+    return 0;
+}
+
 void ft_bzero(void *s, size_t n)
 {
     unsigned char *ptr = s;
@@ -57,4 +72,28 @@ void print_hex(size_t n)
     ft_putstr("0x");
     while (i > 0)
         ft_putchar(buffer[--i]);
-}
\ No newline at end of file
+}
+
+// Parse "<digits>[K|M|G]" as used by the FT_MALLOC_* size settings.
+// Returns 0 for malformed input.
+size_t ft_parse_size(const char *s)
+{
+    size_t n = 0;
+    
+    if (!s || *s < '0' || *s > '9')
+        return 0;
+    while (*s >= '0' && *s <= '9')
+        n = n * 10 + (size_t)(*s++ - '0');
+    
+    if (*s == 'k' || *s == 'K')
+        n <<= 10;
+    else if (*s == 'm' || *s == 'M')
+        n <<= 20;
+    else if (*s == 'g' || *s == 'G')
+        n <<= 30;
+    else if (*s)
+        return 0;
+    if (*s && s[1])
+        return 0;
+    return n;
+}
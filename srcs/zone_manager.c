@@ -1,20 +1,20 @@
 #include "malloc.h"
 
-t_zone *create_zone(size_t size, int type)
+void init_zone(t_zone *zone, size_t size, int type)
 {
-    t_zone *zone;
     t_block *block;
     size_t usable_size;
     
-    zone = mmap(NULL, size, PROT_READ | PROT_WRITE, 
-                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (zone == MAP_FAILED)
-        return NULL;
-    
     zone->next = NULL;
     zone->prev = NULL;
     zone->size = size;
     zone->type = type;
+    zone->flags = 0;
+    if (type == MEDIUM_ZONE)
+    {
+        medium_init_zone(zone);
+        return;
+    }
     zone->free_blocks = 1;
     
     // Calculate usable size (total size minus zone header)
@@ -25,10 +25,68 @@ t_zone *create_zone(size_t size, int type)
     block = (t_block *)((char *)zone + ZONE_HEADER_SIZE);
     block->size = SET_FREE(usable_size);
     block->prev_size = 0;
+}
+
+t_zone *create_zone(size_t size, int type)
+{
+    t_zone *zone;
     
+    if (!budget_admit(size))
+        return NULL;
+    
+    // Carve from the reserved range when there is one, fall back to a
+    // dedicated mapping once it is exhausted
+    zone = reserve_zone(size);
+    if (!zone)
+    {
+        zone = mmap(NULL, size, PROT_READ | PROT_WRITE, 
+                    MAP_PRIVATE | MAP_ANONYMOUS
+                    | (PREFAULT_ZONES && type <= SMALL_ZONE ? MAP_POPULATE : 0),
+                    -1, 0);
+        if (zone == MAP_FAILED)
+            return NULL;
+        g_malloc_data.stats.syscalls++;
+    }
+    
+    latency_path(type == LARGE_ZONE ? LAT_PATH_SYSCALL : LAT_PATH_NEW_ZONE);
+    adopt_zone(zone, size, type);
     return zone;
 }
 
+// Account for freshly mapped memory and lay a zone out in it
+void adopt_zone(t_zone *zone, size_t size, int type)
+{
+    t_malloc_stats *stats = &g_malloc_data.stats;
+    
+    stats->mapped += size;
+    stats->zones[type]++;
+    if (stats->mapped > stats->peak_mapped)
+        stats->peak_mapped = stats->mapped;
+    if (stats->zones[type] > stats->peak_zones[type])
+        stats->peak_zones[type] = stats->zones[type];
+    init_zone(zone, size, type);
+}
+
+int zone_is_reserved(void *ptr)
+{
+    t_reserve *r = &g_malloc_data.reserve;
+    
+    return (char *)ptr >= r->base && (char *)ptr < r->base + r->size;
+}
+
+void destroy_zone(t_zone *zone)
+{
+    latency_path(LAT_PATH_SYSCALL);
+    g_malloc_data.stats.mapped -= zone->size;
+    g_malloc_data.stats.zones[zone->type]--;
+    g_malloc_data.stats.destroyed++;
+    if (zone_is_reserved(zone))
+        reserve_release(zone);
+    else
+        munmap(zone, zone->size);
+    g_malloc_data.stats.syscalls++;
+}
+
 void add_zone(t_zone **list, t_zone *zone)
 {
     t_zone *current;
@@ -64,16 +122,35 @@ void remove_zone(t_zone **list, t_zone *zone)
         zone->next->prev = zone->prev;
 }
 
-int zone_is_empty(t_zone *zone)
+// First block of a zone; MEDIUM zones start theirs after the page map
+t_block *zone_first_block(t_zone *zone)
 {
-    return zone->free_size == zone->size - ZONE_HEADER_SIZE - BLOCK_HEADER_SIZE;
+    t_medium *medium;
+    
+    if (zone->type != MEDIUM_ZONE)
+        return (t_block *)((char *)zone + ZONE_HEADER_SIZE);
+    medium = (t_medium *)((char *)zone + ZONE_HEADER_SIZE);
+    return (t_block *)((char *)zone + (size_t)medium->first * getpagesize());
 }
 
-t_zone *find_zone_for_ptr(void *ptr)
+// free_size of the zone when nothing is allocated in it
+size_t zone_capacity(t_zone *zone)
 {
-    t_zone *zone;
+    t_medium *medium;
     
-    zone = g_malloc_data.tiny_zones;
+    if (zone->type != MEDIUM_ZONE)
+        return zone->size - ZONE_HEADER_SIZE - BLOCK_HEADER_SIZE;
+    medium = (t_medium *)((char *)zone + ZONE_HEADER_SIZE);
+    return (size_t)medium->pages * getpagesize();
+}
+
+int zone_is_empty(t_zone *zone)
+{
+    return zone->free_size == zone_capacity(zone);
+}
+
+t_zone *find_zone_in_list(t_zone *zone, void *ptr)
+{
     while (zone)
     {
         if (ptr >= (void *)zone && ptr < (void *)((char *)zone + zone->size))
@@ -81,21 +158,32 @@ t_zone *find_zone_for_ptr(void *ptr)
         zone = zone->next;
     }
     
-    zone = g_malloc_data.small_zones;
-    while (zone)
-    {
-        if (ptr >= (void *)zone && ptr < (void *)((char *)zone + zone->size))
-            return zone;
-        zone = zone->next;
-    }
+    return NULL;
+}
+
+t_zone *find_zone_for_ptr(void *ptr)
+{
+    t_zone *zone;
     
-    zone = g_malloc_data.large_zones;
-    while (zone)
+    t_region *region;
+    
+    if (zone_is_reserved(ptr))
+        return reserve_find_zone(ptr);
+    
+    zone = find_zone_in_list(g_malloc_data.tiny_zones, ptr);
+    if (!zone)
+        zone = find_zone_in_list(g_malloc_data.small_zones, ptr);
+    if (!zone)
+        zone = find_zone_in_list(g_malloc_data.medium_zones, ptr);
+    if (!zone)
+        zone = find_zone_in_list(g_malloc_data.large_zones, ptr);
+    
+    region = g_malloc_data.regions;
+    while (!zone && region)
     {
-        if (ptr >= (void *)zone && ptr < (void *)((char *)zone + zone->size))
-            return zone;
-        zone = zone->next;
+        zone = find_zone_in_list(region->zones, ptr);
+        region = region->next;
     }
     
-    return NULL;
-}
\ No newline at end of file
+    return zone;
+}
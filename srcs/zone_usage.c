@@ -0,0 +1,146 @@
+#include "malloc.h"
+
+static size_t largest_free_block(t_zone *zone, size_t *deferred)
+{
+    t_block *block;
+    char *zone_end;
+    size_t block_size;
+    size_t largest = 0;
+
+    zone_end = (char *)zone + zone->size;
+    block = zone_first_block(zone);
+
+    while ((char *)block < zone_end)
+    {
+        block_size = GET_SIZE(block->size);
+        if (block_size == 0 || (char *)block + BLOCK_HEADER_SIZE + block_size > zone_end)
+            break;
+        if (IS_FREE(block->size) && block_size > largest)
+            largest = block_size;
+        if (IS_QUICK(block->size))
+            (*deferred)++;
+        block = (t_block *)((char *)block + BLOCK_HEADER_SIZE + block_size);
+    }
+
+    return largest;
+}
+
+static void fill_usage(t_zone *zone, t_zone_usage *usage)
+{
+    t_zone *head;
+    size_t usable;
+
+    usable = zone_capacity(zone);
+
+    usage->zone = zone;
+    usage->zone_size = zone->size;
+    usage->free_size = zone->free_size;
+    usage->used_size = usable - zone->free_size;
+    usage->free_blocks = zone->free_blocks;
+    usage->deferred_blocks = 0;
+    usage->largest_free = largest_free_block(zone, &usage->deferred_blocks);
+    usage->type = zone->type;
+    usage->occupancy = (int)(usage->used_size * 100 / usable);
+    usage->draining = (zone->flags & ZONE_DRAINING) != 0;
+
+    // LARGE zones hold a single block and are released by free() anyway.
+    // Otherwise moving out only pays off when another zone of the tier can
+    // take the object, since free() keeps the last zone of each tier.
+    usage->should_move = 0;
+    if (zone->type != LARGE_ZONE && !(zone->flags & ZONE_REGION))
+    {
+        head = *get_zone_list(zone->type);
+        if (head != zone || zone->next != NULL)
+            usage->should_move = usage->draining
+                || usage->occupancy < DRAIN_THRESHOLD;
+    }
+}
+
+int malloc_zone_usage(void *ptr, t_zone_usage *usage)
+{
+    t_zone *zone;
+
+    if (!ptr || !usage)
+        return -1;
+
+    zone = find_zone_for_ptr(ptr);
+    if (!zone)
+        return -1;
+
+    fill_usage(zone, usage);
+    return 0;
+}
+
+size_t malloc_zone_usage_batch(void **ptrs, size_t count, t_zone_usage *usages)
+{
+    t_zone *zone;
+    t_zone *last = NULL;
+    size_t last_index = 0;
+    size_t found = 0;
+    size_t i;
+
+    if (!ptrs || !usages)
+        return 0;
+
+    for (i = 0; i < count; i++)
+    {
+        // Batches usually come from the same few zones, so reuse the last
+        // lookup before walking the zone lists again
+        if (last && (char *)ptrs[i] >= (char *)last
+            && (char *)ptrs[i] < (char *)last + last->size)
+            zone = last;
+        else
+            zone = ptrs[i] ? find_zone_for_ptr(ptrs[i]) : NULL;
+
+        if (!zone)
+        {
+            ft_bzero(&usages[i], sizeof(t_zone_usage));
+            continue;
+        }
+
+        if (zone == last)
+            usages[i] = usages[last_index];
+        else
+            fill_usage(zone, &usages[i]);
+        last = zone;
+        last_index = i;
+        found++;
+    }
+
+    return found;
+}
+
+int malloc_drain_zone(void *ptr, int enable)
+{
+    t_zone *zone;
+
+    zone = ptr ? find_zone_for_ptr(ptr) : NULL;
+    if (!zone || zone->type == LARGE_ZONE || (zone->flags & ZONE_REGION))
+        return -1;
+
+    if (enable)
+        zone->flags |= ZONE_DRAINING;
+    else
+        zone->flags &= ~ZONE_DRAINING;
+    return 0;
+}
+
+void *malloc_compact(size_t size)
+{
+    void *ptr;
+    size_t aligned;
+    int type;
+
+    if (size == 0)
+        return NULL;
+
+    aligned = ALIGN(size);
+    type = get_zone_type(aligned);
+    ptr = allocate_in_list(get_zone_list(type), type, aligned, ZONE_DRAINING);
+
+    if (g_malloc_data.tracing)
+        trace_record(TRACE_MALLOC, ptr, NULL, size);
+    if (g_malloc_data.shm)
+        shm_stats_tick(LAT_MALLOC);
+    return ptr;
+}
@@ -0,0 +1,120 @@
+// test/bench.c
+//
+// Allocator benchmark, run unchanged against every build flavor:
+//
+//   ./malloc_bench                                      (system malloc)
+//   LD_PRELOAD=./libft_malloc_compact.so ./malloc_bench
+//
+// Each phase reports nanoseconds per operation; the last line reports the
+// peak RSS of the whole run.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#define SLOTS       512
+#define ROUNDS      20000
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift32: same sequence for every allocator
+static uint32_t next_random(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void report(const char *phase, uint64_t start, long ops)
+{
+    printf("  %-28s %8.1f ns/op\n", phase, (double)(now_ns() - start) / ops);
+}
+
+// Random frees and allocations over a fixed set of slots
+static void churn(const char *phase, void **slots, size_t min, size_t max)
+{
+    uint32_t seed = 42;
+    uint64_t start;
+    uint32_t r;
+    size_t i;
+    long n;
+
+    start = now_ns();
+    for (n = 0; n < ROUNDS; n++)
+    {
+        r = next_random(&seed);
+        i = r % SLOTS;
+        free(slots[i]);
+        slots[i] = malloc(min + (r >> 12) % (max - min + 1));
+        if (slots[i])
+            memset(slots[i], 0, min);
+    }
+    report(phase, start, ROUNDS);
+    for (i = 0; i < SLOTS; i++)
+    {
+        free(slots[i]);
+        slots[i] = NULL;
+    }
+}
+
+// Same-size allocate/free pairs, the best case for any cache
+static void pairs(size_t size)
+{
+    uint64_t start;
+    void *ptr;
+    long n;
+
+    start = now_ns();
+    for (n = 0; n < ROUNDS; n++)
+    {
+        ptr = malloc(size);
+        *(volatile char *)ptr = 0;
+        free(ptr);
+    }
+    report("malloc/free pairs (64 B)", start, ROUNDS * 2);
+}
+
+// Buffers grown one chunk at a time
+static void growth(void)
+{
+    uint64_t start;
+    char *buf;
+    size_t size;
+    long n;
+    long ops = 0;
+
+    start = now_ns();
+    for (n = 0; n < ROUNDS / 100; n++)
+    {
+        buf = NULL;
+        for (size = 64; size <= 16384; size += 256, ops++)
+            buf = realloc(buf, size);
+        free(buf);
+    }
+    report("realloc growth to 16 KB", start, ops);
+}
+
+int main(void)
+{
+    static void *slots[SLOTS];
+    struct rusage usage;
+
+    pairs(64);
+    churn("churn 16-256 B", slots, 16, 256);
+    churn("churn 16-4096 B", slots, 16, 4096);
+    churn("churn 1-64 KB", slots, 1024, 65536);
+    growth();
+
+    getrusage(RUSAGE_SELF, &usage);
+    printf("  %-28s %8ld KB\n", "peak RSS", usage.ru_maxrss);
+    return 0;
+}
@@ -0,0 +1,160 @@
+// test/bench_locality.c
+//
+// Linked-list traversal with and without malloc_near:
+//
+//   make bench_locality
+//
+// LISTS lists are built one after the other, with a freed spacer after
+// every node so that the heap has slack everywhere, then churned: every
+// round unlinks a random node and inserts a new one after another random
+// node. With plain malloc the new node lands in the first hole in address
+// order; with malloc_near it lands next to its predecessor. After the churn each
+// mode reports the mean distance between consecutive nodes, how often a
+// traversal crosses to another page, and the traversal cost.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "../includes/malloc.h"
+
+#define LISTS       64
+#define LENGTH      96          // Nodes per list
+#define ROUNDS      50000
+#define PASSES      200
+
+typedef struct s_node {
+    struct s_node   *next;
+    uint64_t        value;
+    char            payload[48];
+} t_node;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift32: the same holes for both modes
+static uint32_t next_random(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static t_node *new_node(t_node *prev, int near)
+{
+    t_node *node;
+
+    node = near ? malloc_near(prev, sizeof(t_node)) : malloc(sizeof(t_node));
+    node->next = NULL;
+    node->value = 1;
+    return node;
+}
+
+// Node `index` of a list, the head being node 0
+static t_node *nth(t_node *node, uint32_t index)
+{
+    while (index-- && node->next)
+        node = node->next;
+    return node;
+}
+
+static void run(const char *mode, int near)
+{
+    static t_node *heads[LISTS];
+    static void *spacers[LISTS * LENGTH];
+    t_node *node;
+    t_node *prev;
+    uintptr_t page = getpagesize();
+    uint32_t seed = 42;
+    uint64_t start;
+    uint64_t churn;
+    uint64_t sum = 0;
+    double distance = 0;
+    size_t links = 0;
+    size_t crossings = 0;
+    int i;
+    int n;
+
+    for (i = 0; i < LISTS; i++)
+    {
+        prev = NULL;
+        for (n = 0; n < LENGTH; n++)
+        {
+            node = new_node(prev, near);
+            if (prev)
+                prev->next = node;
+            else
+                heads[i] = node;
+            prev = node;
+            spacers[i * LENGTH + n] = malloc(sizeof(t_node));
+        }
+    }
+    for (i = 0; i < LISTS * LENGTH; i++)
+        free(spacers[i]);
+
+    start = now_ns();
+    for (n = 0; n < ROUNDS; n++)
+    {
+        // Unlink a node past the head...
+        prev = nth(heads[next_random(&seed) % LISTS],
+                   next_random(&seed) % (LENGTH - 1));
+        node = prev->next;
+        if (node)
+        {
+            prev->next = node->next;
+            free(node);
+        }
+        // ...and insert one after a random node
+        prev = nth(heads[next_random(&seed) % LISTS],
+                   next_random(&seed) % LENGTH);
+        node = new_node(prev, near);
+        node->next = prev->next;
+        prev->next = node;
+    }
+    churn = now_ns() - start;
+
+    for (i = 0; i < LISTS; i++)
+        for (node = heads[i]; node->next; node = node->next, links++)
+        {
+            distance += node->next > node ? (char *)node->next - (char *)node
+                                          : (char *)node - (char *)node->next;
+            crossings += (uintptr_t)node / page
+                         != (uintptr_t)node->next / page;
+        }
+
+    start = now_ns();
+    for (n = 0; n < PASSES; n++)
+        for (i = 0; i < LISTS; i++)
+            for (node = heads[i]; node; node = node->next)
+                sum += node->value;
+    printf("  %-12s churn %6.0f ns/round, traverse %5.2f ns/node, "
+           "%8.0f B apart, %5.1f%% page crossings\n", mode,
+           (double)churn / ROUNDS,
+           (double)(now_ns() - start) / ((double)PASSES * (links + LISTS)),
+           distance / links, 100.0 * crossings / links);
+    if (sum == 0)
+        printf("  (empty)\n");
+
+    for (i = 0; i < LISTS; i++)
+    {
+        while (heads[i])
+        {
+            node = heads[i]->next;
+            free(heads[i]);
+            heads[i] = node;
+        }
+    }
+}
+
+int main(void)
+{
+    run("malloc", 0);
+    run("malloc_near", 1);
+    return 0;
+}
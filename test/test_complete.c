@@ -1,12 +1,15 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <signal.h>
 #include <setjmp.h>
 #include <stdint.h>
 #include <time.h>
 #include <sys/resource.h>
+#include <pthread.h>
 #include "../includes/malloc.h"
 
 #define TEST_START(name) write(1, "\n=== " name " ===\n", strlen("\n=== " name " ===\n"))
@@ -381,6 +384,888 @@ void test_performance() {
     tests_passed++;
 }
 
+void test_zone_usage() {
+    TEST_START("Test 11: Zone Usage and Compact Hint");
+    
+    // Enough 64-byte blocks to spill over into a second TINY zone
+    void *ptrs[1200];
+    t_zone_usage usage;
+    t_zone_usage batch[3];
+    for (int i = 0; i < 1200; i++) {
+        ptrs[i] = malloc(64);
+        assert(ptrs[i] != NULL);
+    }
+    
+    assert(malloc_zone_usage(ptrs[0], &usage) == 0);
+    assert(usage.type == TINY_ZONE);
+    assert(usage.occupancy > 70);
+    assert(usage.should_move == 0);
+    assert(malloc_zone_usage((void *)&tests_passed, &usage) == -1);
+    
+    // Leave a single survivor in the first zone
+    void *survivor = ptrs[0];
+    void *first_zone = usage.zone;
+    for (int i = 1; i < 1200; i++) {
+        malloc_zone_usage(ptrs[i], &usage);
+        if (usage.zone == first_zone) {
+            free(ptrs[i]);
+            ptrs[i] = NULL;
+        }
+    }
+    assert(malloc_zone_usage(survivor, &usage) == 0);
+    assert(usage.occupancy < DRAIN_THRESHOLD);
+    assert(usage.should_move == 1);
+    assert(usage.largest_free > 1000);
+    
+    void *lookups[3] = {survivor, NULL, survivor};
+    assert(malloc_zone_usage_batch(lookups, 3, batch) == 2);
+    assert(batch[0].zone == first_zone && batch[1].zone == NULL);
+    assert(batch[2].zone == first_zone);
+    
+    // Compact allocations stay out of a draining zone
+    assert(malloc_drain_zone(survivor, 1) == 0);
+    void *moved = malloc_compact(64);
+    assert(moved != NULL);
+    malloc_zone_usage(moved, &usage);
+    assert(usage.zone != first_zone);
+    safe_memcpy(moved, survivor, 64);
+    free(survivor);
+    
+    free(moved);
+    for (int i = 1; i < 1200; i++)
+        free(ptrs[i]);
+    
+    TEST_PASS("Zone Usage and Compact Hint");
+    tests_passed++;
+}
+
+void test_region() {
+    TEST_START("Test 12: Region Allocation");
+    
+    t_region *region = region_create();
+    assert(region != NULL);
+    
+    // Consecutive allocations are bumped next to each other
+    char *a = region_alloc(region, 24);
+    char *b = region_alloc(region, 100);
+    assert(a != NULL && b != NULL);
+    assert(((uintptr_t)a % 16) == 0 && ((uintptr_t)b % 16) == 0);
+    assert(b == a + ALIGN(24) + BLOCK_HEADER_SIZE);
+    safe_memset(a, 'R', 24);
+    safe_memset(b, 'S', 100);
+    
+    // Popping the most recent allocation rewinds the bump pointer
+    assert(region_free_last(region, a) == -1);
+    assert(region_free_last(region, b) == 0);
+    assert(region_alloc(region, 100) == b);
+    
+    // free() leaves region memory alone, and realloc() only shrinks it
+    free(a);
+    assert(a[0] == 'R');
+    assert(realloc(a, 16) == a);
+    assert(realloc(a, 4096) == NULL);
+    assert(a[0] == 'R');
+    
+    // Spill over several zones, including a dedicated one
+    for (int i = 0; i < 2000; i++)
+        assert(region_alloc(region, 512) != NULL);
+    char *big = region_alloc(region, 1024 * 1024);
+    assert(big != NULL);
+    big[1024 * 1024 - 1] = 'X';
+    
+    t_zone_usage usage;
+    assert(malloc_zone_usage(big, &usage) == 0);
+    assert(usage.should_move == 0);
+    
+    region_reset(region);
+    char *again = region_alloc(region, 64);
+    assert(again != NULL);
+    region_destroy(region);
+    
+    TEST_PASS("Region Allocation");
+    tests_passed++;
+}
+
+void test_reserve() {
+    TEST_START("Test 13: Reserved Address Space");
+    
+    // Either we enable it here or FT_MALLOC_RESERVE already did
+    int enabled = malloc_reserve(256 * 1024 * 1024);
+    assert(enabled == 0 || g_malloc_data.reserve.base != NULL);
+    assert(malloc_reserve(256 * 1024 * 1024) == -1);
+    
+    char *base = g_malloc_data.reserve.base;
+    char *end = base + g_malloc_data.reserve.size;
+    void *large[8];
+    for (int i = 0; i < 8; i++) {
+        large[i] = malloc(2 * MEDIUM_MAX);
+        assert((char *)large[i] > base && (char *)large[i] < end);
+        safe_memset(large[i], 'L', 2 * MEDIUM_MAX);
+    }
+    
+    // Ownership is resolved from the granule table
+    t_zone_usage usage;
+    assert(malloc_zone_usage((char *)large[3] + MEDIUM_MAX, &usage) == 0);
+    assert(usage.type == LARGE_ZONE);
+    assert(malloc_zone_usage(base, &usage) == -1);
+    
+    // Released granules are reused
+    free(large[2]);
+    void *again = malloc(2 * MEDIUM_MAX);
+    assert(again == large[2]);
+#ifndef FT_FLAVOR_DEBUG     // The debug flavor fills new blocks with 0xAA
+    assert(((char *)again)[0] == 0);
+#endif
+    
+    free(again);
+    for (int i = 0; i < 8; i++)
+        if (i != 2)
+            free(large[i]);
+    assert(malloc_zone_usage((char *)large[3] + MEDIUM_MAX, &usage) == -1);
+    
+    TEST_PASS("Reserved Address Space");
+    tests_passed++;
+}
+
+static uint64_t latency_total(const uint64_t *buckets) {
+    uint64_t total = 0;
+    for (int i = 0; i < LAT_BUCKETS; i++)
+        total += buckets[i];
+    return total;
+}
+
+void test_latency() {
+    TEST_START("Test 14: Latency Histograms");
+    
+    static t_latency_snapshot snap;
+    
+    malloc_latency_enable(1);
+    malloc_latency_reset();
+    for (int i = 0; i < 1000; i++)
+        free(malloc(32));
+    void *large = malloc(2 * MEDIUM_MAX);
+    free(large);
+    
+    malloc_latency_snapshot(&snap);
+    assert(snap.ticks_per_us > 0);
+    assert(latency_total(snap.counts[LAT_MALLOC][TINY_ZONE][LAT_PATH_HIT]) >= 1000);
+    assert(latency_total(snap.counts[LAT_FREE][TINY_ZONE][LAT_PATH_HIT]) >= 1000);
+    assert(latency_total(snap.counts[LAT_MALLOC][LARGE_ZONE][LAT_PATH_SYSCALL]) == 1);
+    assert(latency_total(snap.counts[LAT_FREE][LARGE_ZONE][LAT_PATH_SYSCALL]) == 1);
+    
+    uint64_t *hits = snap.counts[LAT_MALLOC][TINY_ZONE][LAT_PATH_HIT];
+    assert(malloc_latency_percentile(hits, 50.0) <= malloc_latency_percentile(hits, 99.9));
+    assert(malloc_latency_percentile(hits, 99.9) <= malloc_latency_percentile(hits, 100.0));
+    
+    write(1, "\n--- Latency ---\n", 17);
+    show_alloc_latency();
+    write(1, "--- End Latency ---\n", 20);
+    
+    // A reset drops everything recorded so far
+    malloc_latency_reset();
+    malloc_latency_snapshot(&snap);
+    assert(latency_total(snap.counts[LAT_MALLOC][TINY_ZONE][LAT_PATH_HIT]) == 0);
+    
+    // A pointer that is not ours has no tier to be recorded under
+    volatile void *unknown = (void *)&tests_passed;
+    free((void *)unknown);
+    malloc_latency_snapshot(&snap);
+    for (int tier = 0; tier < ZONE_TYPES; tier++)
+        for (int path = 0; path < LAT_PATHS; path++)
+            assert(latency_total(snap.counts[LAT_FREE][tier][path]) == 0);
+    
+    malloc_latency_enable(0);
+    free(malloc(32));
+    malloc_latency_snapshot(&snap);
+    assert(latency_total(snap.counts[LAT_MALLOC][TINY_ZONE][LAT_PATH_HIT]) == 0);
+    
+    TEST_PASS("Latency Histograms");
+    tests_passed++;
+}
+
+static size_t churn_and_measure(void **ptrs, int count, t_zone_usage *usage) {
+    for (int i = 0; i < count; i++)
+        ptrs[i] = malloc(16 + (i % 7) * 16);
+    void *probe = malloc(16);
+    for (int i = 0; i < count; i += 2)
+        free(ptrs[i]);
+    for (int i = 1; i < count; i += 2)
+        free(ptrs[i]);
+    malloc_flush_deferred();
+    malloc_zone_usage(probe, usage);
+    free(probe);
+    return usage->largest_free;
+}
+
+void test_deferred() {
+    TEST_START("Test 15: Deferred Coalescing");
+    
+    void *ptrs[200];
+    t_zone_usage usage;
+    
+    // Baseline fragmentation with immediate coalescing
+    malloc_deferred_enable(0);
+    size_t immediate = churn_and_measure(ptrs, 200, &usage);
+    
+    malloc_deferred_enable(1);
+    size_t hits = g_malloc_data.quick.hits;
+    
+    // Same-size churn is a push/pop on the quick list
+    void *a = malloc(200);
+    free(a);
+    void *b = malloc(200);
+    assert(a == b);
+    assert(g_malloc_data.quick.hits == hits + 1);
+    
+    // Parked blocks stay allocated from the zone's point of view
+    free(b);
+    assert(malloc_zone_usage(b, &usage) == 0);
+    assert(usage.deferred_blocks == 1);
+    free(b);    // Double free of a parked block is ignored
+    assert(g_malloc_data.quick.total == 1);
+    malloc_flush_deferred();
+    malloc_zone_usage(b, &usage);
+    assert(usage.deferred_blocks == 0);
+    
+    // Once swept, coalescing quality matches the immediate mode
+    size_t deferred = churn_and_measure(ptrs, 200, &usage);
+    assert(deferred == immediate);
+    assert(g_malloc_data.quick.sweeps > 0);
+    
+    malloc_deferred_enable(0);
+    assert(g_malloc_data.quick.total == 0);
+    
+    TEST_PASS("Deferred Coalescing");
+    tests_passed++;
+}
+
+static int budget_calls = 0;
+static void *budget_victim = NULL;
+
+// Budget callback: free one held allocation, then give up
+static int release_victim(size_t requested, size_t mapped) {
+    (void)requested;
+    (void)mapped;
+    budget_calls++;
+    if (!budget_victim)
+        return 0;
+    free(budget_victim);
+    budget_victim = NULL;
+    return 1;
+}
+
+void test_budget() {
+    TEST_START("Test 16: Memory Budget");
+    
+    size_t soft = g_malloc_data.budget.soft_limit;
+    size_t hard = g_malloc_data.budget.hard_limit;
+    size_t mapped = g_malloc_data.stats.mapped;
+    
+    // Crossing the soft limit reclaims instead of failing
+    size_t reclaims = g_malloc_data.stats.reclaims;
+    malloc_set_budget(mapped, 0);
+    void *large = malloc(2 * MEDIUM_MAX);
+    assert(large != NULL);
+    assert(g_malloc_data.stats.reclaims == reclaims + 1);
+    free(large);
+    
+    // Hard limit: fail with ENOMEM once the callback has nothing left
+    malloc_set_budget(0, g_malloc_data.stats.mapped + 4 * MEDIUM_MAX);
+    malloc_set_budget_callback(release_victim);
+    errno = 0;
+    assert(malloc(8 * MEDIUM_MAX) == NULL);
+    assert(errno == ENOMEM);
+    assert(budget_calls == 1);
+    
+    // The callback can make room by freeing memory of its own
+    budget_victim = malloc(3 * MEDIUM_MAX);
+    assert(budget_victim != NULL);
+    large = malloc(2 * MEDIUM_MAX);
+    assert(large != NULL && budget_victim == NULL);
+    assert(budget_calls == 2);
+    assert(g_malloc_data.stats.mapped <= g_malloc_data.budget.hard_limit);
+    free(large);
+    
+    malloc_set_budget_callback(NULL);
+    malloc_set_budget(soft, hard);
+    assert(g_malloc_data.stats.peak_mapped >= g_malloc_data.stats.mapped);
+    
+    TEST_PASS("Memory Budget");
+    tests_passed++;
+}
+
+void test_profile() {
+    TEST_START("Test 17: Heap Profile Warm-up");
+    
+    const char *path = "/tmp/ft_malloc_test.prof";
+    t_heap_profile profile;
+    void *ptrs[100];
+    
+    for (int i = 0; i < 100; i++)
+        ptrs[i] = malloc(i < 50 ? 64 : 1000);
+    assert(malloc_profile_save(path) == 0);
+    for (int i = 0; i < 100; i++)
+        free(ptrs[i]);
+    
+    assert(malloc_profile_load(path, &profile) == 0);
+    assert(profile.classes[64 / 16 - 1] >= 50);
+    assert(profile.classes[1008 / 16 - 1] >= 50);
+    assert(profile.zones[TINY_ZONE] >= 1 && profile.zones[SMALL_ZONE] >= 1);
+    assert(malloc_profile_load("/nonexistent/profile", &profile) == -1);
+    
+    // Ask for a few more zones than are live and prefault them
+    size_t tiny = g_malloc_data.stats.zones[TINY_ZONE];
+    size_t small = g_malloc_data.stats.zones[SMALL_ZONE];
+    profile.zones[TINY_ZONE] = tiny + 3;
+    profile.zones[SMALL_ZONE] = small + 2;
+    assert(malloc_warm(&profile, 1) == 5);
+    assert(g_malloc_data.stats.zones[TINY_ZONE] == tiny + 3);
+    assert(g_malloc_data.stats.zones[SMALL_ZONE] == small + 2);
+    
+    // A second warm-up is a no-op, and warm zones serve allocations
+    // without mapping anything new
+    assert(malloc_warm(&profile, 0) == 0);
+    size_t mapped = g_malloc_data.stats.mapped;
+    void *p = malloc(2000);
+    assert(p != NULL && g_malloc_data.stats.mapped == mapped);
+    free(p);
+    
+    malloc_reclaim();
+    unlink(path);
+    
+    TEST_PASS("Heap Profile Warm-up");
+    tests_passed++;
+}
+
+void test_shm_stats() {
+    TEST_START("Test 18: Shared-Memory Stats");
+    
+    char name[32] = SHM_STATS_PREFIX;
+    size_t len = sizeof(SHM_STATS_PREFIX) - 1;
+    char digits[16];
+    size_t n = 0;
+    for (pid_t pid = getpid(); pid; pid /= 10)
+        digits[n++] = '0' + pid % 10;
+    while (n)
+        name[len++] = digits[--n];
+    name[len] = '\0';
+    
+    int was_on = g_malloc_data.shm != NULL;
+    assert(malloc_stats_publish(1) == 0);
+    
+    // Attach the way mallocstat does, through a separate read-only mapping
+    int fd = shm_open(name, O_RDONLY, 0);
+    assert(fd >= 0);
+    const t_shm_stats *page = mmap(NULL, sizeof(t_shm_stats), PROT_READ,
+                                   MAP_SHARED, fd, 0);
+    close(fd);
+    assert(page != MAP_FAILED);
+    assert(memcmp(page->magic, SHM_STATS_MAGIC, 8) == 0);
+    assert(page->pid == (uint32_t)getpid());
+    
+    // Call counters are live, tier totals refresh every SHM_STATS_EVERY calls
+    uint64_t seq = page->seq;
+    uint64_t mallocs = page->calls[LAT_MALLOC];
+    uint64_t frees = page->calls[LAT_FREE];
+    void *ptrs[SHM_STATS_EVERY];
+    for (int i = 0; i < SHM_STATS_EVERY; i++)
+        ptrs[i] = malloc(100);
+    assert(page->calls[LAT_MALLOC] == mallocs + SHM_STATS_EVERY);
+    assert(page->seq > seq);
+    shm_stats_refresh();
+    assert(page->tiers[TINY_ZONE].used >= SHM_STATS_EVERY * 112);
+    assert(page->tiers[TINY_ZONE].zones == g_malloc_data.stats.zones[TINY_ZONE]);
+    for (int i = 0; i < SHM_STATS_EVERY; i++)
+        free(ptrs[i]);
+    assert(page->calls[LAT_FREE] == frees + SHM_STATS_EVERY);
+    
+    // Aligned, compact and sized calls are counted too
+    void *aligned = aligned_alloc(64, 100);
+    void *compact = malloc_compact(100);
+    assert(page->calls[LAT_MALLOC] == mallocs + SHM_STATS_EVERY + 2);
+    free_sized(compact, 100);
+    free_aligned_sized(aligned, 64, 100);
+    assert(page->calls[LAT_FREE] == frees + SHM_STATS_EVERY + 2);
+    
+    // Region zones are part of their tier's totals
+    t_region *region = region_create();
+    assert(region_alloc(region, 100) != NULL);
+    assert(region_alloc(region, 1024 * 1024) != NULL);
+    shm_stats_refresh();
+    uint64_t mapped = 0;
+    for (int type = 0; type < ZONE_TYPES; type++)
+    {
+        assert(page->tiers[type].zones == g_malloc_data.stats.zones[type]);
+        mapped += page->tiers[type].mapped;
+    }
+    assert(mapped == g_malloc_data.stats.mapped);
+    region_destroy(region);
+    
+    // Turning it off removes the page
+    assert(malloc_stats_publish(0) == 0);
+    assert(g_malloc_data.shm == NULL);
+    assert(shm_open(name, O_RDONLY, 0) < 0);
+    munmap((void *)page, sizeof(t_shm_stats));
+    if (was_on)
+        malloc_stats_publish(1);
+    
+    TEST_PASS("Shared-Memory Stats");
+    tests_passed++;
+}
+
+void test_medium() {
+    TEST_START("Test 19: Medium Tier");
+    
+    t_zone_usage usage;
+    t_zone_usage before;
+    size_t page = getpagesize();
+    
+    // 4 KB - 1 MB requests share MEDIUM zones
+    void *p = malloc(5000);
+    assert(malloc_zone_usage(p, &usage) == 0 && usage.type == MEDIUM_ZONE);
+    assert(((uintptr_t)p & (page - 1)) == BLOCK_HEADER_SIZE);
+    void *edge = malloc(MEDIUM_MAX);
+    assert(malloc_zone_usage(edge, &usage) == 0 && usage.type == MEDIUM_ZONE);
+    void *huge = malloc(MEDIUM_MAX + 1);
+    assert(malloc_zone_usage(huge, &usage) == 0 && usage.type == LARGE_ZONE);
+    free(edge);
+    free(huge);
+    
+    // Steady-state churn does not go back to the kernel
+    size_t syscalls = g_malloc_data.stats.syscalls;
+    for (int i = 0; i < 1000; i++)
+        free(malloc(20000 + i * 16));
+    if (!PURGE_ON_FREE)
+        assert(g_malloc_data.stats.syscalls == syscalls);
+    
+    // Neighbouring runs merge back, whatever the free order
+    malloc_zone_usage(p, &before);
+    char *a = malloc(8000);
+    char *b = malloc(8000);
+    char *c = malloc(8000);
+    assert(b == a + 2 * page && c == b + 2 * page);
+    free(a);
+    free(c);
+    free(a);            // Double free is ignored
+    free(b + 16);       // So is a pointer inside a run
+    free(b);
+    malloc_zone_usage(p, &usage);
+    assert(usage.free_size == before.free_size);
+    assert(usage.free_blocks == before.free_blocks);
+    assert(usage.largest_free == before.largest_free);
+    
+    // realloc keeps the data, aligned requests get their alignment
+    safe_memset(p, 'M', 5000);
+    char *grown = realloc(p, 500000);
+    assert(grown && grown[0] == 'M' && grown[4999] == 'M');
+    void *aligned = aligned_alloc(4096, 8000);
+    assert(aligned && ((uintptr_t)aligned & 4095) == 0);
+    free(aligned);
+    errno = 0;
+    assert(aligned_alloc(48, 100) == NULL && errno == EINVAL);
+    free(grown);
+    
+    write(1, "\n--- Medium ---\n", 16);
+    void *shown = malloc(10000);
+    show_alloc_mem();
+    free(shown);
+    write(1, "--- End Medium ---\n", 19);
+    
+    TEST_PASS("Medium Tier");
+    tests_passed++;
+}
+
+typedef struct s_pnode {
+    struct s_pnode  *next;
+    size_t          value;
+} t_pnode;
+
+typedef struct s_proot {
+    t_pnode         *list;
+    char            *blob;
+} t_proot;
+
+void test_pheap() {
+    TEST_START("Test 20: Persistent Heap");
+    
+    const char *path = "/tmp/ft_malloc_test.heap";
+    size_t blob_size = 3 * PHEAP_ZONE_PAGES * getpagesize();
+    unlink(path);
+    
+    t_pheap *heap = pheap_open(path, NULL, 0);
+    assert(heap && (uintptr_t)heap->header == PHEAP_BASE);
+    assert(pheap_open(path, NULL, 0) == NULL);      // Already open
+    
+    // Build a structure, with holes, larger than one zone
+    t_proot *root = pheap_alloc(heap, sizeof(t_proot));
+    t_pnode *dropped[500];
+    root->list = NULL;
+    for (size_t i = 0; i < 1000; i++) {
+        t_pnode *node = pheap_alloc(heap, sizeof(t_pnode));
+        if (i % 2) {
+            dropped[i / 2] = node;
+            continue;
+        }
+        node->value = i;
+        node->next = root->list;
+        root->list = node;
+    }
+    for (int i = 0; i < 500; i++)
+        pheap_free(heap, dropped[i]);
+    root->blob = pheap_alloc(heap, blob_size);
+    assert(root->blob);
+    memset(root->blob, 'P', blob_size);
+    pheap_set_root(heap, root);
+    assert(pheap_check(heap) == 0);
+    assert(pheap_close(heap) == 0);
+    
+    // A restart finds everything in place through the root
+    heap = pheap_open(path, NULL, 0);
+    assert(heap && pheap_root(heap) == root);
+    size_t expected = 998;
+    for (t_pnode *node = root->list; node; node = node->next) {
+        assert(node->value == expected);
+        expected -= 2;
+    }
+    assert(root->blob[0] == 'P' && root->blob[blob_size - 1] == 'P');
+    assert(pheap_check(heap) == 0);
+    
+    // Freed nodes are reused, freeing the root clears it
+    void *again = pheap_alloc(heap, sizeof(t_pnode));
+    int reused = 0;
+    for (int i = 0; i < 500; i++)
+        reused |= again == dropped[i];
+    assert(reused);
+    t_pnode *list = root->list;
+    pheap_free(heap, again);
+    pheap_free(heap, root->blob);
+    pheap_free(heap, root);
+    assert(pheap_root(heap) == NULL);
+    assert(pheap_check(heap) == 0);
+    pheap_set_root(heap, list);
+    assert(pheap_close(heap) == 0);
+    
+    // A damaged block is caught by the full check
+    int fd = open(path, O_RDWR);
+    uint64_t bad = 12345;
+    assert(pwrite(fd, &bad, sizeof(bad), getpagesize() + ZONE_HEADER_SIZE) == sizeof(bad));
+    heap = pheap_open(path, NULL, 0);
+    assert(heap && pheap_check(heap) == -1);
+    pheap_close(heap);
+    
+    // A damaged header keeps the heap from opening at all
+    assert(pwrite(fd, "X", 1, 0) == 1);
+    close(fd);
+    errno = 0;
+    assert(pheap_open(path, NULL, 0) == NULL && errno == EINVAL);
+    unlink(path);
+    
+    TEST_PASS("Persistent Heap");
+    tests_passed++;
+}
+
+static int g_reader_inside = 0;
+static int g_reader_done = 0;
+
+static void *epoch_reader(void *arg) {
+    volatile size_t *node = arg;
+    size_t sum = 0;
+    
+    malloc_epoch_enter();
+    __atomic_store_n(&g_reader_inside, 1, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(&g_reader_done, __ATOMIC_ACQUIRE))
+        sum += node[0];
+    malloc_epoch_exit();
+    return (void *)sum;
+}
+
+// Writers take turns: the allocator has no locks, so two threads retiring
+// at the same time is not supported
+static void *epoch_retirer(void *arg) {
+    void **nodes = arg;
+    
+    for (int i = 0; i < 8; i++)
+        free_deferred(nodes[i]);
+    return NULL;
+}
+
+static void *epoch_adopter(void *arg) {
+    free_deferred(malloc(48));
+    *(size_t *)arg = malloc_epoch_reclaim();
+    return NULL;
+}
+
+static int block_is_live(void *ptr) {
+    t_block *block = (t_block *)((char *)ptr - BLOCK_HEADER_SIZE);
+    return !IS_FREE(block->size) && !IS_QUICK(block->size);
+}
+
+void test_epoch() {
+    TEST_START("Test 21: Epoch Reclamation");
+    
+    void *nodes[100];
+    
+    // Nothing is freed while this thread is still reading
+    for (int i = 0; i < 100; i++)
+        nodes[i] = malloc(48);
+    malloc_epoch_enter();
+    malloc_epoch_enter();       // Sections nest
+    for (int i = 0; i < 100; i++)
+        free_deferred(nodes[i]);
+    malloc_epoch_exit();
+    assert(malloc_epoch_reclaim() == 0);
+    for (int i = 0; i < 100; i++)
+        assert(block_is_live(nodes[i]));
+    malloc_epoch_exit();
+    assert(malloc_epoch_reclaim() == 100);
+    assert(malloc_epoch_reclaim() == 0);
+    
+    // Nor while another thread is inside a section that saw the block
+    size_t *shared = malloc(sizeof(size_t));
+    *shared = 1;
+    pthread_t reader;
+    assert(pthread_create(&reader, NULL, epoch_reader, shared) == 0);
+    while (!__atomic_load_n(&g_reader_inside, __ATOMIC_ACQUIRE))
+        ;
+    free_deferred(shared);
+    assert(malloc_epoch_reclaim() == 0);
+    assert(malloc_epoch_reclaim() == 0);
+    assert(block_is_live(shared));
+    __atomic_store_n(&g_reader_done, 1, __ATOMIC_RELEASE);
+    pthread_join(reader, NULL);
+    assert(malloc_epoch_reclaim() == 1);
+    
+    // An exited writer's pending blocks go to the next thread that retires
+    pthread_t writer;
+    size_t reclaimed = 0;
+    for (int i = 0; i < 8; i++)
+        nodes[i] = malloc(48);
+    assert(pthread_create(&writer, NULL, epoch_retirer, nodes) == 0);
+    pthread_join(writer, NULL);
+    for (int i = 0; i < 8; i++)
+        assert(block_is_live(nodes[i]));
+    assert(pthread_create(&writer, NULL, epoch_adopter, &reclaimed) == 0);
+    pthread_join(writer, NULL);
+    assert(reclaimed == 9);
+    
+    // Steady retirement outside sections reclaims in batches
+    for (int i = 0; i < 10 * EPOCH_BATCH; i++)
+        free_deferred(malloc(64));
+    assert(malloc_epoch_reclaim() <= EPOCH_BATCH);
+    free_deferred(NULL);
+    
+    TEST_PASS("Epoch Reclamation");
+    tests_passed++;
+}
+
+static size_t distance(void *a, void *b) {
+    return a > b ? (size_t)((char *)a - (char *)b) : (size_t)((char *)b - (char *)a);
+}
+
+void test_near() {
+    TEST_START("Test 22: Allocation Near a Hint");
+    
+    t_zone_usage hint_zone;
+    t_zone_usage usage;
+    char *c[10];
+    
+    for (int i = 0; i < 10; i++)
+        c[i] = malloc(64);
+    free(c[6]);
+    free(c[7]);
+    malloc_flush_deferred();
+    
+    // The closest free space wins, and free space before the hint is
+    // carved from its end
+    char *near = malloc_near(c[8], 32);
+    assert(near && distance(near, c[8]) <= distance(c[7], c[8]));
+    assert(malloc_zone_usage(c[8], &hint_zone) == 0);
+    assert(malloc_zone_usage(near, &usage) == 0 && usage.zone == hint_zone.zone);
+    if (c[8] == c[7] + 64 + BLOCK_HEADER_SIZE)
+        assert(near == c[8] - BLOCK_HEADER_SIZE - 32);
+    
+    // Other tiers and missing hints take the normal path
+    char *other = malloc_near(c[0], 2000);
+    assert(malloc_zone_usage(other, &usage) == 0 && usage.type == SMALL_ZONE);
+    char *plain = malloc_near(NULL, 100);
+    assert(plain);
+    assert(malloc_near(c[0], 0) == NULL);
+    
+    // MEDIUM hints keep the new run in the same zone
+    char *medium = malloc(20000);
+    char *medium_near = malloc_near(medium, 30000);
+    malloc_zone_usage(medium, &hint_zone);
+    assert(malloc_zone_usage(medium_near, &usage) == 0 && usage.zone == hint_zone.zone);
+    
+    free(medium_near);
+    free(medium);
+    free(plain);
+    free(other);
+    free(near);
+    for (int i = 0; i < 10; i++)
+        if (i != 6 && i != 7)
+            free(c[i]);
+    
+    TEST_PASS("Allocation Near a Hint");
+    tests_passed++;
+}
+
+#define ITERATE_MAGIC 0x17E4A7E17E4A7E17ULL
+
+typedef struct s_census {
+    void    *wanted[4];
+    size_t  sizes[4];
+    int     found[4];
+    size_t  zones;
+    size_t  live;
+    size_t  free;
+    int     bad_kind;
+} t_census;
+
+static int census_visitor(const t_heap_entry *entry, void *arg) {
+    t_census *census = arg;
+    
+    if (entry->kind == HEAP_ZONE) {
+        census->zones++;
+        return 0;
+    }
+    if (entry->kind == HEAP_FREE) {
+        census->free++;
+        return 0;
+    }
+    census->live++;
+    for (int i = 0; i < 4; i++)
+        if (entry->ptr == census->wanted[i] && entry->size >= census->sizes[i])
+            census->found[i] = 1;
+    return 0;
+}
+
+static int only_free_visitor(const t_heap_entry *entry, void *arg) {
+    if (entry->kind != HEAP_FREE)
+        ((t_census *)arg)->bad_kind = 1;
+    return 0;
+}
+
+static int stop_visitor(const t_heap_entry *entry, void *arg) {
+    (void)entry;
+    (void)arg;
+    return 1;
+}
+
+static int freeing_visitor(const t_heap_entry *entry, void *arg) {
+    if (entry->size >= sizeof(uint64_t) && *(uint64_t *)entry->ptr == ITERATE_MAGIC) {
+        *(uint64_t *)entry->ptr = 0;
+        free(entry->ptr);
+        (*(size_t *)arg)++;
+    }
+    return 0;
+}
+
+void test_iterate() {
+    TEST_START("Test 23: Heap Iteration");
+    
+    t_census census = {0};
+    size_t sizes[4] = {100, 2000, 20000, 2 * MEDIUM_MAX};
+    
+    for (int i = 0; i < 4; i++) {
+        census.sizes[i] = sizes[i];
+        census.wanted[i] = malloc(sizes[i]);
+    }
+    
+    // Every tier is visited, zones first
+    size_t visited = malloc_iterate(HEAP_VISIT_ALL, census_visitor, &census);
+    assert(visited == census.zones + census.live + census.free);
+    for (int i = 0; i < 4; i++)
+        assert(census.found[i]);
+    size_t zones = 0;
+    for (int i = 0; i < ZONE_TYPES; i++)
+        zones += g_malloc_data.stats.zones[i];
+    assert(census.zones == zones);
+    
+    // Filters and early stop
+    census.bad_kind = 0;
+    malloc_iterate(HEAP_VISIT_FREE, only_free_visitor, &census);
+    assert(!census.bad_kind);
+    assert(malloc_iterate(HEAP_VISIT_ALL, stop_visitor, NULL) == 1);
+    assert(malloc_iterate(HEAP_VISIT_ALL, NULL, NULL) == 0);
+    
+    // Visitors run on a copy of the zone, so they may free what they see,
+    // even the last block of a zone still to come
+    void *tagged[64];
+    for (int i = 0; i < 64; i++) {
+        tagged[i] = malloc(i % 2 ? 3000 : 2 * MEDIUM_MAX);
+        *(uint64_t *)tagged[i] = ITERATE_MAGIC;
+    }
+    size_t freed = 0;
+    malloc_iterate(HEAP_VISIT_LIVE, freeing_visitor, &freed);
+    assert(freed == 64);
+    freed = 0;
+    malloc_iterate(HEAP_VISIT_LIVE, freeing_visitor, &freed);
+    assert(freed == 0);
+    
+    for (int i = 0; i < 4; i++)
+        free(census.wanted[i]);
+    
+    TEST_PASS("Heap Iteration");
+    tests_passed++;
+}
+
+void test_adaptive_classes() {
+    TEST_START("Test 24: Adaptive Size Classes");
+    
+    t_class_report report;
+    
+    // Just past a page: MEDIUM rounds 4200 bytes up to two pages
+    malloc_adaptive_enable(1);
+    void *ptr = malloc(4200);
+    assert(find_zone_for_ptr(ptr)->type == MEDIUM_ZONE);
+    free(ptr);
+    
+    // One epoch of such requests moves the boundary just above them
+    malloc_class_report(&report);
+    for (int i = 0; i < 64 * CLASS_EPOCH * CLASS_SAMPLE_EVERY
+                    && report.derivations == 0; i++) {
+        free(malloc(4200));
+        malloc_class_report(&report);
+    }
+    assert(report.derivations == 1);
+    assert(report.small_max == ALIGN(4200));
+    void *kept = malloc(4200);
+    assert(find_zone_for_ptr(kept)->type == SMALL_ZONE);
+    for (int i = 0; i < CLASS_SAMPLE_EVERY; i++)
+        free(malloc(4200));
+    malloc_class_report(&report);
+    assert(report.frag_learned < report.frag_fixed);
+    ptr = malloc(5000);
+    assert(find_zone_for_ptr(ptr)->type == MEDIUM_ZONE);
+    free(ptr);
+    
+    // Two exact pages waste nothing in MEDIUM; once the old samples have
+    // decayed the boundary goes back, while the block placed before stays
+    for (int i = 0; i < 64 * CLASS_EPOCH * CLASS_SAMPLE_EVERY
+                    && report.small_max != SMALL_MAX; i++) {
+        free(malloc(2 * getpagesize() - BLOCK_HEADER_SIZE));
+        malloc_class_report(&report);
+    }
+    assert(report.small_max == SMALL_MAX);
+    ptr = malloc(4200);
+    assert(find_zone_for_ptr(ptr)->type == MEDIUM_ZONE);
+    assert(find_zone_for_ptr(kept)->type == SMALL_ZONE);
+    kept = realloc(kept, 4300);
+    assert(kept && find_zone_for_ptr(kept)->type == MEDIUM_ZONE);
+    free(kept);
+    free(ptr);
+    
+    // Disabled, nothing is sampled
+    malloc_adaptive_enable(0);
+    free(malloc(4200));
+    malloc_class_report(&report);
+    assert(report.sampled == 0 && report.small_max == SMALL_MAX);
+    
+    TEST_PASS("Adaptive Size Classes");
+    tests_passed++;
+}
+
 int main(void) {
     write(1, "=== COMPREHENSIVE MALLOC TEST SUITE (FIXED) ===\n", 48);
     write(1, "Using write() to avoid printf malloc calls\n", 43);
@@ -397,6 +1282,20 @@ int main(void) {
     test_show_alloc_mem();
     test_allocation_limits();
     test_performance();
+    test_zone_usage();
+    test_region();
+    test_reserve();
+    test_latency();
+    test_deferred();
+    test_budget();
+    test_profile();
+    test_shm_stats();
+    test_medium();
+    test_pheap();
+    test_epoch();
+    test_near();
+    test_iterate();
+    test_adaptive_classes();
     
     // Summary
     write(1, "\n=== TEST SUMMARY ===\n", 22);
@@ -0,0 +1,144 @@
+// test/test_cxx.cpp
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <list>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../includes/malloc_resource.hpp"
+
+#define ITERATIONS  20000
+
+struct alignas(64) CacheLine {
+    char data[64];
+};
+
+static bool owned(const void *ptr)
+{
+    t_zone_usage usage;
+
+    return malloc_zone_usage(const_cast<void *>(ptr), &usage) == 0;
+}
+
+static void test_operators()
+{
+    int *one = new int(42);
+    int *many = new int[1000];
+    CacheLine *line = new CacheLine;
+    CacheLine *lines = new CacheLine[7];
+    int *nothrow = new (std::nothrow) int(1);
+
+    // Every form must land in our zones, aligned forms on their alignment
+    assert(owned(one) && owned(many) && owned(line) && owned(nothrow));
+    assert(reinterpret_cast<uintptr_t>(line) % alignof(CacheLine) == 0);
+    assert(reinterpret_cast<uintptr_t>(lines) % alignof(CacheLine) == 0);
+    assert(*one == 42);
+
+    delete one;
+    delete[] many;
+    delete line;
+    delete[] lines;
+    delete nothrow;
+
+    std::pmr::memory_resource *resource = ft::malloc_memory_resource();
+    void *page = resource->allocate(4096, 4096);
+    assert(owned(page) && reinterpret_cast<uintptr_t>(page) % 4096 == 0);
+    resource->deallocate(page, 4096, 4096);
+    assert(resource->is_equal(*ft::malloc_memory_resource()));
+    assert(!resource->is_equal(*std::pmr::new_delete_resource()));
+
+    std::printf("[PASS] operator new/delete and memory_resource\n");
+}
+
+template <class Clock = std::chrono::steady_clock>
+class Timer {
+public:
+    explicit Timer(const char *name) : name_(name), start_(Clock::now()) {}
+    ~Timer()
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - start_);
+        std::printf("  %-40s %8.2f ms\n", name_, elapsed.count() / 1000.0);
+    }
+
+private:
+    const char                  *name_;
+    typename Clock::time_point  start_;
+};
+
+template <class Vector, class Map, class Hash, class List, class String>
+static void run_containers(const char *label, Vector vec, Map map, Hash hash,
+                           List list, String str)
+{
+    std::printf("%s\n", label);
+    {
+        Timer<> t("vector<int> push_back");
+        for (int i = 0; i < ITERATIONS; i++)
+            vec.push_back(i);
+    }
+    {
+        Timer<> t("map<int, int> insert + erase");
+        for (int i = 0; i < ITERATIONS; i++)
+            map[i] = i;
+        for (int i = 0; i < ITERATIONS; i += 2)
+            map.erase(i);
+    }
+    {
+        Timer<> t("unordered_map<int, int> insert + erase");
+        for (int i = 0; i < ITERATIONS; i++)
+            hash[i] = i;
+        for (int i = 0; i < ITERATIONS; i += 2)
+            hash.erase(i);
+    }
+    {
+        Timer<> t("list<int> push_back + pop_front");
+        for (int i = 0; i < ITERATIONS; i++)
+            list.push_back(i);
+        while (!list.empty())
+            list.pop_front();
+    }
+    {
+        Timer<> t("string append");
+        for (int i = 0; i < ITERATIONS; i++)
+            str.append("0123456789");
+    }
+    assert(vec.size() == ITERATIONS && map.size() == ITERATIONS / 2);
+    assert(hash.size() == ITERATIONS / 2);
+    assert(str.size() == ITERATIONS * 10);
+}
+
+int main()
+{
+    std::printf("=== C++ INTEGRATION TEST ===\n");
+    test_operators();
+
+    std::printf("\n=== STL CONTAINER BENCHMARK ===\n");
+    run_containers("std::allocator (operator new)",
+                   std::vector<int>(), std::map<int, int>(),
+                   std::unordered_map<int, int>(), std::list<int>(),
+                   std::string());
+
+    std::pmr::memory_resource *resource = ft::malloc_memory_resource();
+    run_containers("std::pmr (ft::malloc_memory_resource)",
+                   std::pmr::vector<int>(resource),
+                   std::pmr::map<int, int>(resource),
+                   std::pmr::unordered_map<int, int>(resource),
+                   std::pmr::list<int>(resource),
+                   std::pmr::string(resource));
+
+    typedef ft::malloc_allocator<std::pair<const int, int>> pair_alloc;
+    run_containers("ft::malloc_allocator",
+                   std::vector<int, ft::malloc_allocator<int>>(),
+                   std::map<int, int, std::less<int>, pair_alloc>(),
+                   std::unordered_map<int, int, std::hash<int>,
+                                      std::equal_to<int>, pair_alloc>(),
+                   std::list<int, ft::malloc_allocator<int>>(),
+                   std::basic_string<char, std::char_traits<char>,
+                                     ft::malloc_allocator<char>>());
+
+    std::printf("\nALL TESTS PASSED!\n");
+    return 0;
+}
@@ -0,0 +1,367 @@
+// tools/malloc_replay.c
+//
+// Replays a trace recorded with FT_MALLOC_TRACE against whichever malloc
+// the process is linked with:
+//
+//   ./malloc_replay trace.bin                              (system malloc)
+//   LD_PRELOAD=./libft_malloc.so ./malloc_replay trace.bin (ft_malloc)
+//
+// All bookkeeping (trace buffer, pointer map) lives in private mappings so
+// that only the replayed calls go through the allocator under test.
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../includes/malloc.h"
+
+#define RSS_SAMPLE_EVERY    1024
+#define RSS_SAMPLE_GROWTH   (1024 * 1024)
+
+typedef struct s_slot {
+    uint64_t    id;         // Address seen by the recording process
+    void        *ptr;       // Address returned during replay
+    size_t      size;
+} t_slot;
+
+typedef struct s_replay {
+    t_slot      *slots;
+    size_t      mask;
+    size_t      live_bytes;
+    size_t      peak_live;
+    size_t      peak_rss;
+    size_t      sampled_live;
+    size_t      ops;
+    size_t      skipped;
+    int         statm_fd;
+    long        page_size;
+} t_replay;
+
+static void *map_anon(size_t size)
+{
+    void *mem;
+
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return mem == MAP_FAILED ? NULL : mem;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static size_t read_rss(t_replay *r)
+{
+    char buf[128];
+    ssize_t len;
+    char *p;
+    size_t pages = 0;
+
+    len = pread(r->statm_fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0)
+        return 0;
+    buf[len] = '\0';
+    // statm: size resident shared ...
+    p = strchr(buf, ' ');
+    if (!p)
+        return 0;
+    while (*++p >= '0' && *p <= '9')
+        pages = pages * 10 + (size_t)(*p - '0');
+    return pages * (size_t)r->page_size;
+}
+
+// Open addressing with linear probing, keyed by the recorded address
+static t_slot *slot_find(t_replay *r, uint64_t id, int insert)
+{
+    size_t i;
+
+    i = (size_t)((id >> 4) * 0x9E3779B97F4A7C15ULL) & r->mask;
+    while (r->slots[i].id)
+    {
+        if (r->slots[i].id == id)
+            return &r->slots[i];
+        i = (i + 1) & r->mask;
+    }
+    return insert ? &r->slots[i] : NULL;
+}
+
+static void slot_remove(t_replay *r, t_slot *slot)
+{
+    size_t i;
+    size_t j;
+    size_t home;
+
+    // Backward-shift deletion keeps probe chains intact without tombstones
+    i = (size_t)(slot - r->slots);
+    j = i;
+    while (1)
+    {
+        j = (j + 1) & r->mask;
+        if (!r->slots[j].id)
+            break;
+        home = (size_t)((r->slots[j].id >> 4) * 0x9E3779B97F4A7C15ULL)
+               & r->mask;
+        if ((j > i && (home <= i || home > j))
+            || (j < i && (home <= i && home > j)))
+        {
+            r->slots[i] = r->slots[j];
+            i = j;
+        }
+    }
+    r->slots[i].id = 0;
+}
+
+static void touch(void *ptr, size_t size, long page_size)
+{
+    char *p = ptr;
+    size_t off;
+
+    // Write one byte per page so the RSS reflects what an application sees
+    for (off = 0; off < size; off += (size_t)page_size)
+        p[off] = 1;
+    if (size)
+        p[size - 1] = 1;
+}
+
+static void track(t_replay *r, uint64_t id, void *ptr, size_t size)
+{
+    t_slot *slot;
+
+    if (!ptr || !id)
+        return;
+    slot = slot_find(r, id, 1);
+    if (slot->id)
+        r->live_bytes -= slot->size;
+    slot->id = id;
+    slot->ptr = ptr;
+    slot->size = size;
+    r->live_bytes += size;
+    if (r->live_bytes > r->peak_live)
+        r->peak_live = r->live_bytes;
+    touch(ptr, size, r->page_size);
+}
+
+static void untrack(t_replay *r, t_slot *slot)
+{
+    r->live_bytes -= slot->size;
+    slot_remove(r, slot);
+}
+
+static void replay_event(t_replay *r, const t_trace_event *ev)
+{
+    t_slot *slot;
+    void *ptr;
+    size_t rss;
+
+    if (ev->op == TRACE_MALLOC)
+        track(r, ev->ptr, malloc(ev->size), ev->size);
+    else if (ev->op == TRACE_FREE)
+    {
+        slot = slot_find(r, ev->arg, 0);
+        if (!slot)
+        {
+            r->skipped++;
+            return;
+        }
+        free(slot->ptr);
+        untrack(r, slot);
+    }
+    else if (ev->op == TRACE_REALLOC)
+    {
+        slot = ev->arg ? slot_find(r, ev->arg, 0) : NULL;
+        if (ev->arg && !slot)
+        {
+            r->skipped++;
+            return;
+        }
+        ptr = realloc(slot ? slot->ptr : NULL, ev->size);
+        if (slot && (ptr || ev->size == 0))
+            untrack(r, slot);
+        track(r, ev->ptr, ptr, ev->size);
+    }
+    r->ops++;
+    // Sample periodically, and whenever the live set grew noticeably so
+    // that short spikes are not missed
+    if (r->ops % RSS_SAMPLE_EVERY == 0
+        || r->live_bytes > r->sampled_live + RSS_SAMPLE_GROWTH)
+    {
+        r->sampled_live = r->live_bytes;
+        rss = read_rss(r);
+        if (rss > r->peak_rss)
+            r->peak_rss = rss;
+    }
+}
+
+// Ties keep file order, which is call order within a thread: a malloc and
+// the free that follows it can share a timestamp
+static int event_before(const t_trace_event *ev, size_t a, size_t b)
+{
+    if (ev[a].timestamp != ev[b].timestamp)
+        return ev[a].timestamp < ev[b].timestamp;
+    return a < b;
+}
+
+static void sift_down(const t_trace_event *ev, size_t *order, size_t root,
+                      size_t count)
+{
+    size_t child;
+    size_t tmp;
+
+    while ((child = root * 2 + 1) < count)
+    {
+        if (child + 1 < count
+            && event_before(ev, order[child], order[child + 1]))
+            child++;
+        if (!event_before(ev, order[root], order[child]))
+            return;
+        tmp = order[root];
+        order[root] = order[child];
+        order[child] = tmp;
+        root = child;
+    }
+}
+
+// Heapsort of event indices: per-thread rings are flushed independently, so
+// the file is only sorted per thread. Sorting indices into a private
+// mapping avoids touching malloc, and the index breaks timestamp ties.
+static size_t *sort_events(const t_trace_event *ev, size_t count)
+{
+    size_t *order;
+    size_t i;
+    size_t tmp;
+
+    order = map_anon((count ? count : 1) * sizeof(size_t));
+    if (!order)
+        return NULL;
+    for (i = 0; i < count; i++)
+        order[i] = i;
+    for (i = count / 2; i-- > 0; )
+        sift_down(ev, order, i, count);
+    for (i = count; i-- > 1; )
+    {
+        tmp = order[0];
+        order[0] = order[i];
+        order[i] = tmp;
+        sift_down(ev, order, 0, i);
+    }
+    return order;
+}
+
+// With FT_MALLOC_ADAPTIVE=1, the internal fragmentation of the sampled
+// requests with SMALL_MAX and with the learned SMALL/MEDIUM boundary. The
+// external side shows up in peak RSS above.
+static void print_classes(void)
+{
+    void (*report_fn)(t_class_report *);
+    t_class_report report;
+
+    *(void **)&report_fn = dlsym(RTLD_DEFAULT, "malloc_class_report");
+    if (!report_fn)
+        return;
+    report_fn(&report);
+    if (report.sampled == 0)
+        return;
+    printf("small max      : %zu (%zu derivations)\n", report.small_max,
+           report.derivations);
+    printf("internal frag  : %zu KB -> %zu KB (%.1f%% -> %.1f%% of %zu KB "
+           "sampled)\n", report.frag_fixed / 1024, report.frag_learned / 1024,
+           100.0 * (double)report.frag_fixed / (double)report.requested,
+           100.0 * (double)report.frag_learned / (double)report.requested,
+           report.requested / 1024);
+}
+
+int main(int argc, char **argv)
+{
+    t_replay r;
+    t_trace_header *header;
+    t_trace_event *events;
+    size_t *order;
+    struct stat st;
+    size_t count;
+    size_t cap;
+    size_t i;
+    size_t base_rss;
+    uint64_t start;
+    uint64_t elapsed;
+    int fd;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s <trace file>\n", argv[0]);
+        return 1;
+    }
+
+    fd = open(argv[1], O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(*header))
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    header = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED
+        || memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != TRACE_VERSION
+        || header->event_size != sizeof(t_trace_event))
+    {
+        fprintf(stderr, "%s: not a version %d ft_malloc trace\n",
+                argv[1], TRACE_VERSION);
+        return 1;
+    }
+    events = (t_trace_event *)(header + 1);
+    count = ((size_t)st.st_size - sizeof(*header)) / sizeof(t_trace_event);
+    order = sort_events(events, count);
+
+    memset(&r, 0, sizeof(r));
+    for (cap = 1024; cap < count * 2; cap <<= 1)
+        ;
+    r.slots = map_anon(cap * sizeof(t_slot));
+    r.mask = cap - 1;
+    r.page_size = sysconf(_SC_PAGESIZE);
+    r.statm_fd = open("/proc/self/statm", O_RDONLY);
+    if (!r.slots || !order)
+    {
+        perror("mmap");
+        return 1;
+    }
+    // Fault in the pointer map so it does not count towards the replay
+    memset(r.slots, 0, cap * sizeof(t_slot));
+    base_rss = read_rss(&r);
+
+    start = now_ns();
+    for (i = 0; i < count; i++)
+        replay_event(&r, &events[order[i]]);
+    elapsed = now_ns() - start;
+    if (read_rss(&r) > r.peak_rss)
+        r.peak_rss = read_rss(&r);
+
+    printf("allocator      : %s\n",
+           dlsym(RTLD_DEFAULT, "show_alloc_mem") ? "ft_malloc" : "system");
+    printf("events         : %zu (%zu skipped", r.ops, r.skipped);
+    if (header->dropped)
+        printf(", %llu dropped while recording",
+               (unsigned long long)header->dropped);
+    printf(")\n");
+    printf("time           : %.3f ms (%.1f ns/op)\n", elapsed / 1e6,
+           r.ops ? (double)elapsed / (double)r.ops : 0.0);
+    printf("peak live      : %zu KB\n", r.peak_live / 1024);
+    printf("peak RSS       : %zu KB\n",
+           r.peak_rss > base_rss ? (r.peak_rss - base_rss) / 1024 : 0);
+    printf("fragmentation  : %.1f%%\n",
+           r.peak_rss > base_rss && r.peak_rss - base_rss > r.peak_live
+           ? 100.0 * (double)(r.peak_rss - base_rss - r.peak_live)
+             / (double)(r.peak_rss - base_rss)
+           : 0.0);
+    print_classes();
+    return 0;
+}
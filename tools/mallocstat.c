@@ -0,0 +1,193 @@
+// tools/mallocstat.c
+//
+// Prints the allocator counters published by a process running with
+// FT_MALLOC_SHM=1, without touching the process itself:
+//
+//   ./mallocstat <pid>                     (one sample)
+//   ./mallocstat <pid> <interval> [count]  (one line every <interval> ms)
+//
+// Like vmstat, the first line shows totals since the page was created and
+// later lines show rates over the last interval.
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "../includes/malloc.h"
+
+#define LOAD(field)     __atomic_load_n(&(field), __ATOMIC_RELAXED)
+#define HEADER_EVERY    20
+
+static const t_shm_stats *attach(const char *pid)
+{
+    const t_shm_stats *page;
+    char name[64];
+    int fd;
+
+    snprintf(name, sizeof(name), "%s%s", SHM_STATS_PREFIX, pid);
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        fprintf(stderr, "mallocstat: no stats page for pid %s "
+                "(is it running with FT_MALLOC_SHM=1?)\n", pid);
+        return NULL;
+    }
+    page = mmap(NULL, sizeof(t_shm_stats), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED)
+    {
+        perror("mallocstat: mmap");
+        return NULL;
+    }
+    if (memcmp(page->magic, SHM_STATS_MAGIC, sizeof(page->magic)) != 0
+        || page->version != SHM_STATS_VERSION)
+    {
+        fprintf(stderr, "mallocstat: %s is not a version %d stats page\n",
+                name, SHM_STATS_VERSION);
+        return NULL;
+    }
+    return page;
+}
+
+// Copy the page field by field; no field is torn, but fields may come from
+// different refreshes
+static void sample(const t_shm_stats *page, t_shm_stats *out)
+{
+    int op;
+    int t;
+
+    out->seq = LOAD(page->seq);
+    for (op = 0; op < LAT_OPS; op++)
+        out->calls[op] = LOAD(page->calls[op]);
+    out->syscalls = LOAD(page->syscalls);
+    out->quick_hits = LOAD(page->quick_hits);
+    out->quick_misses = LOAD(page->quick_misses);
+    out->reclaims = LOAD(page->reclaims);
+    out->peak_mapped = LOAD(page->peak_mapped);
+    for (t = 0; t < ZONE_TYPES; t++)
+    {
+        out->tiers[t].mapped = LOAD(page->tiers[t].mapped);
+        out->tiers[t].used = LOAD(page->tiers[t].used);
+        out->tiers[t].free = LOAD(page->tiers[t].free);
+        out->tiers[t].zones = LOAD(page->tiers[t].zones);
+        out->tiers[t].free_blocks = LOAD(page->tiers[t].free_blocks);
+    }
+}
+
+static void print_header(void)
+{
+    printf("%-24s %-24s %-24s %-17s %-30s %s\n",
+           "---------tiny---------", "---------small--------",
+           "--------medium--------",
+           "------large------", "-----------calls/s------------",
+           "--------------------");
+    printf("%7s %7s %4s %3s %7s %7s %4s %3s %7s %7s %4s %3s "
+           "%8s %8s %9s %9s %9s %6s %4s %7s\n",
+           "usedK", "freeK", "zone", "fr%", "usedK", "freeK", "zone", "fr%",
+           "usedK", "freeK", "zone", "fr%",
+           "mapK", "zones", "malloc", "free", "realloc", "sys/s", "hit%",
+           "peakK");
+}
+
+// Share of free blocks beyond one per zone: a fully coalesced tier has
+// at most one free block per zone, so 0% means no splintering
+static unsigned fragmentation(const t_shm_tier *tier)
+{
+    if (tier->free_blocks <= tier->zones)
+        return 0;
+    return (unsigned)(100 * (tier->free_blocks - tier->zones)
+                      / tier->free_blocks);
+}
+
+static void print_row(const t_shm_stats *now, const t_shm_stats *prev,
+                      double seconds)
+{
+    const t_shm_tier *t = now->tiers;
+    uint64_t lookups;
+    uint64_t hits;
+    char hit_rate[8];
+
+    // Quick-list hit rate, only meaningful with FT_MALLOC_DEFERRED=1
+    hits = now->quick_hits - prev->quick_hits;
+    lookups = hits + now->quick_misses - prev->quick_misses;
+    if (lookups)
+        snprintf(hit_rate, sizeof(hit_rate), "%lu",
+                 (unsigned long)(100 * hits / lookups));
+    else
+        snprintf(hit_rate, sizeof(hit_rate), "-");
+    printf("%7lu %7lu %4lu %3u %7lu %7lu %4lu %3u %7lu %7lu %4lu %3u "
+           "%8lu %8lu "
+           "%9.0f %9.0f %9.0f %6.0f %4s %7lu\n",
+           (unsigned long)(t[TINY_ZONE].used / 1024),
+           (unsigned long)(t[TINY_ZONE].free / 1024),
+           (unsigned long)t[TINY_ZONE].zones, fragmentation(&t[TINY_ZONE]),
+           (unsigned long)(t[SMALL_ZONE].used / 1024),
+           (unsigned long)(t[SMALL_ZONE].free / 1024),
+           (unsigned long)t[SMALL_ZONE].zones, fragmentation(&t[SMALL_ZONE]),
+           (unsigned long)(t[MEDIUM_ZONE].used / 1024),
+           (unsigned long)(t[MEDIUM_ZONE].free / 1024),
+           (unsigned long)t[MEDIUM_ZONE].zones, fragmentation(&t[MEDIUM_ZONE]),
+           (unsigned long)(t[LARGE_ZONE].mapped / 1024),
+           (unsigned long)t[LARGE_ZONE].zones,
+           (now->calls[LAT_MALLOC] - prev->calls[LAT_MALLOC]) / seconds,
+           (now->calls[LAT_FREE] - prev->calls[LAT_FREE]) / seconds,
+           (now->calls[LAT_REALLOC] - prev->calls[LAT_REALLOC]) / seconds,
+           (now->syscalls - prev->syscalls) / seconds,
+           hit_rate, (unsigned long)(now->peak_mapped / 1024));
+}
+
+static double elapsed(const struct timespec *a, const struct timespec *b)
+{
+    return (double)(b->tv_sec - a->tv_sec)
+           + (double)(b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    const t_shm_stats *page;
+    t_shm_stats prev;
+    t_shm_stats now;
+    struct timespec last;
+    struct timespec current;
+    long interval = 0;
+    long count = -1;
+    long i;
+
+    if (argc < 2 || argc > 4)
+    {
+        fprintf(stderr, "usage: %s <pid> [interval_ms [count]]\n", argv[0]);
+        return 1;
+    }
+    if (argc >= 3)
+        interval = atol(argv[2]);
+    if (argc == 4)
+        count = atol(argv[3]);
+    page = attach(argv[1]);
+    if (!page)
+        return 1;
+
+    memset(&prev, 0, sizeof(prev));
+    clock_gettime(CLOCK_MONOTONIC, &last);
+    for (i = 0; count < 0 || i < count; i++)
+    {
+        if (i % HEADER_EVERY == 0)
+            print_header();
+        sample(page, &now);
+        clock_gettime(CLOCK_MONOTONIC, &current);
+        // The first line reports totals, like vmstat
+        print_row(&now, &prev, i == 0 ? 1.0 : elapsed(&last, &current));
+        fflush(stdout);
+        if (interval <= 0)
+            break;
+        // Stop once the process has unmapped and unlinked its page
+        if (kill((pid_t)page->pid, 0) != 0)
+            break;
+        prev = now;
+        last = current;
+        usleep((useconds_t)interval * 1000);
+    }
+    return 0;
+}